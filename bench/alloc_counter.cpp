@@ -0,0 +1,21 @@
+// Counting replacement for the global allocation functions, used by the
+// benchmarks to report bytes/op and allocations/op.
+
+#include <cstdlib>
+#include <new>
+
+#include "bench.h"
+
+void* operator new(std::size_t size) {
+  bench::alloc_count.fetch_add(1, std::memory_order_relaxed);
+  bench::alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
@@ -0,0 +1,98 @@
+// Overhead of allocation tracking and a sample report.
+//
+// usage: coolkit_alloc_bench [filter] [min_time_seconds]
+// This program replaces the global operator new with the tracking one, so
+// it doesn't link alloc_counter.cpp and bytes/op stays zero.
+
+#define COOLKIT_ALLOC_TRACK_NEW
+#include "coolkit/alloc_track.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "coolkit/memstat.h"
+#include "coolkit/pprint.h"
+
+struct Record {
+  std::string name;
+  int age;
+  std::vector<std::string> tags;
+  INLINE_PRINT(Record, name, age, tags);
+};
+MEMSTAT_STRUCT(Record, name, age, tags);
+
+namespace {
+
+// new/delete of mixed sizes, as a container-heavy workload does
+void churn(size_t n) {
+  void* ptrs[16];
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < 16; ++j) ptrs[j] = ::operator new(16 + j * 24);
+    for (size_t j = 0; j < 16; ++j) ::operator delete(ptrs[j]);
+  }
+}
+
+void churn_malloc(size_t n) {
+  void* ptrs[16];
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < 16; ++j) ptrs[j] = std::malloc(16 + j * 24);
+    for (size_t j = 0; j < 16; ++j) std::free(ptrs[j]);
+    bench::do_not_optimize(ptrs);
+  }
+}
+
+template <typename F>
+void on_threads(size_t nthreads, F f) {
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < nthreads; ++i) threads.emplace_back(f);
+  for (auto& thread : threads) thread.join();
+}
+
+std::vector<Record> make_records(size_t n) {
+  std::vector<Record> records;
+  for (size_t i = 0; i < n; ++i)
+    records.push_back({"record number " + std::to_string(i), int(i),
+                       {"tag", "another rather long tag"}});
+  return records;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bench::Runner runner;
+  if (argc > 1) runner.filter = argv[1];
+  if (argc > 2) runner.min_time = std::atof(argv[2]);
+  bench::Runner::header();
+
+  // 16 allocations and 16 frees per op
+  runner.run("alloc/malloc", [] { churn_malloc(1); });
+  runner.run("alloc/tracked_new", [] { churn(1); });
+  {
+    const AllocScope scope{"bench"};
+    runner.run("alloc/tracked_new/scoped", [] { churn(1); });
+  }
+  runner.run("alloc/malloc/4_threads",
+             [] { on_threads(4, [] { churn_malloc(1000); }); });
+  runner.run("alloc/tracked_new/4_threads",
+             [] { on_threads(4, [] { churn(1000); }); });
+  runner.run("alloc/tracked_allocator", [] {
+    std::vector<int, TrackedAllocator<int>> vec;
+    for (int i = 0; i < 64; ++i) vec.push_back(i);
+    bench::do_not_optimize(vec.data());
+  });
+
+  // report: tracked live bytes next to the memstat estimate
+  const AllocTag tag = alloc_tag("records");
+  std::vector<Record> records;
+  {
+    const AllocScope scope{tag};
+    records = make_records(1000);
+  }
+  std::cout << "\n";
+  printout(alloc_check(tag, records));
+  printout(alloc_stats());
+}
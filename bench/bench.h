@@ -0,0 +1,97 @@
+#pragma once
+
+// Minimal self-contained microbenchmark harness for coolkit.
+//
+// Each case is calibrated until it runs for at least `min_time`, then
+// reported as ns/op, bytes/op and allocations/op. Allocation numbers come
+// from the counting operator new in alloc_counter.cpp; targets that don't
+// link it report zeros.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <streambuf>
+#include <string_view>
+
+namespace bench {
+
+inline std::atomic<size_t> alloc_count{0};
+inline std::atomic<size_t> alloc_bytes{0};
+
+template <typename T>
+inline void do_not_optimize(const T& val) {
+  asm volatile("" : : "r,m"(val) : "memory");
+}
+
+// Swallows everything written to it, for timing stream output without IO
+class NullBuf : public std::streambuf {
+ protected:
+  int overflow(int ch) override { return ch; }
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+struct Result {
+  double ns_per_op = 0;
+  double bytes_per_op = 0;
+  double allocs_per_op = 0;
+};
+
+struct Runner {
+  std::string_view filter;
+  double min_time = 0.1;  // seconds
+
+  bool enabled(std::string_view name) const {
+    return filter.empty() || name.find(filter) != std::string_view::npos;
+  }
+
+  static void header() {
+    std::printf("%-44s %14s %12s %12s\n", "benchmark", "ns/op", "bytes/op",
+                "allocs/op");
+  }
+
+  template <typename F>
+  Result run(std::string_view name, F&& f) const {
+    Result res;
+    if (!enabled(name)) return res;
+    using clock = std::chrono::steady_clock;
+
+    f();  // warm up caches and function-local statics
+    size_t iters = 1;
+    for (;;) {
+      const size_t count0 = alloc_count.load(std::memory_order_relaxed);
+      const size_t bytes0 = alloc_bytes.load(std::memory_order_relaxed);
+      const auto start = clock::now();
+      for (size_t i = 0; i < iters; ++i) f();
+      const double elapsed =
+          std::chrono::duration<double>(clock::now() - start).count();
+      if (elapsed >= min_time || iters >= (size_t(1) << 30)) {
+        res.ns_per_op = elapsed * 1e9 / iters;
+        res.allocs_per_op =
+            double(alloc_count.load(std::memory_order_relaxed) - count0) /
+            iters;
+        res.bytes_per_op =
+            double(alloc_bytes.load(std::memory_order_relaxed) - bytes0) /
+            iters;
+        break;
+      }
+      iters = elapsed < min_time / 10
+                  ? iters * 10
+                  : size_t(double(iters) * 1.2 * min_time / elapsed) + 1;
+    }
+    std::printf("%-44.*s %14.1f %12.1f %12.2f\n", int(name.size()),
+                name.data(), res.ns_per_op, res.bytes_per_op,
+                res.allocs_per_op);
+    return res;
+  }
+
+  // Reports a result of run() as throughput over `bytes` per op
+  static void throughput(std::string_view name, const Result& res,
+                         size_t bytes) {
+    if (res.ns_per_op <= 0) return;
+    std::printf("%-44.*s %14.2f GB/s\n", int(name.size()), name.data(),
+                double(bytes) / res.ns_per_op);
+  }
+};
+
+}  // namespace bench
@@ -0,0 +1,139 @@
+// Compile-time benchmark for a project with many translation units.
+//
+// Generates N translation units that each print and memstat a few structs
+// and times compiling all of them, first with the coolkit headers parsed in
+// every TU, then with a precompiled header. GCC's -ftime-report of one TU
+// shows the split between parsing and template instantiation.
+//
+// usage: coolkit_compile_bench [ntus] [jobs]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef COOLKIT_BENCH_CXX
+#define COOLKIT_BENCH_CXX "c++"
+#endif
+#ifndef COOLKIT_BENCH_INCLUDE
+#define COOLKIT_BENCH_INCLUDE "include"
+#endif
+
+static const char* dir = "compile_bench";
+
+static void generate_header(const std::string& path) {
+  std::ofstream out(path);
+  out << "#include <map>\n#include <optional>\n#include <sstream>\n"
+      << "#include <string>\n#include <tuple>\n#include <vector>\n"
+      << "#include \"coolkit/enum.h\"\n#include \"coolkit/memstat.h\"\n"
+      << "#include \"coolkit/pprint.h\"\n";
+}
+
+static void generate_tu(const std::string& path, int tu) {
+  std::ofstream out(path);
+  out << "#include \"coolkit_all.h\"\n\n";
+  for (int i = 0; i < 4; ++i) {
+    const std::string name =
+        "S" + std::to_string(tu) + "_" + std::to_string(i);
+    out << "enum struct E" << name << " { a, b, c };\n"
+        << "ENUM(E" << name << ", a, b, c)\n"
+        << "struct " << name << " {\n"
+        << "  std::string name;\n  int id;\n  std::vector<double> values;\n"
+        << "  std::map<int, std::string> tags;\n"
+        << "  INLINE_PRINT(" << name << ", name, id, values, tags);\n"
+        << "  INLINE_MEMSTAT(" << name << ", name, id, values, tags);\n};\n"
+        << "std::string print_" << name << "() {\n"
+        << "  std::ostringstream os;\n"
+        << "  print(os, std::vector<" << name << ">{});\n"
+        << "  print(os, std::map<int, " << name << ">{});\n"
+        << "  print(os, std::optional<" << name << ">{});\n"
+        << "  print(os, std::make_tuple(1, " << name
+        << "{}, std::string{}));\n"
+        << "  os << memstat(std::vector<" << name << ">{});\n"
+        << "  return os.str();\n}\n\n";
+  }
+}
+
+static bool run(const std::string& cmd) {
+  if (std::system(cmd.c_str()) == 0) return true;
+  std::cerr << "command failed: " << cmd << "\n";
+  return false;
+}
+
+// Runs the commands on `jobs` threads; returns wall seconds
+static double run_all(const std::vector<std::string>& cmds, int jobs) {
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next{0};
+  std::atomic<bool> ok{true};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < jobs; ++i) {
+    threads.emplace_back([&] {
+      for (size_t j; (j = next++) < cmds.size();)
+        if (!run(cmds[j])) ok = false;
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  if (!ok) std::exit(1);
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(stop - start).count();
+}
+
+// The parsing and template instantiation lines of -ftime-report
+static void time_report(const std::string& cmd) {
+  const std::string report = std::string(dir) + "/time_report.txt";
+  if (!run(cmd + " -ftime-report 2> " + report)) return;
+  std::ifstream in(report);
+  for (std::string line; std::getline(in, line);) {
+    if (line.find("phase parsing") != std::string::npos ||
+        line.find("template instantiation") != std::string::npos ||
+        line.find("TOTAL") != std::string::npos)
+      std::cout << "   " << line << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  const int ntus = argc > 1 ? std::atoi(argv[1]) : 16;
+  const int jobs = argc > 2 ? std::atoi(argv[2])
+                            : int(std::thread::hardware_concurrency());
+  const std::string plain = std::string(dir) + "/plain";
+  const std::string pch = std::string(dir) + "/pch";
+  if (!run("mkdir -p " + plain + " " + pch)) return 1;
+  generate_header(plain + "/coolkit_all.h");
+  generate_header(pch + "/coolkit_all.h");
+  for (int i = 0; i < ntus; ++i)
+    generate_tu(std::string(dir) + "/tu" + std::to_string(i) + ".cpp", i);
+
+  const std::string cxx = std::string(COOLKIT_BENCH_CXX) +
+                          " -std=c++17 -I" COOLKIT_BENCH_INCLUDE;
+  std::cout << ntus << " translation units, " << jobs << " jobs\n";
+
+  const std::string pch_cmd =
+      cxx + " -x c++-header " + pch + "/coolkit_all.h -o " + pch +
+      "/coolkit_all.h.gch";
+  const double pch_time = run_all({pch_cmd}, 1);
+
+  struct Mode {
+    const char* name;
+    std::string include;
+    double setup;
+  } modes[] = {{"headers", plain, 0}, {"pch", pch, pch_time}};
+  for (const auto& mode : modes) {
+    std::vector<std::string> cmds;
+    for (int i = 0; i < ntus; ++i) {
+      const std::string tu = std::string(dir) + "/tu" + std::to_string(i);
+      cmds.push_back(cxx + " -I" + mode.include + " -c " + tu + ".cpp -o " +
+                     tu + "." + mode.name + ".o");
+    }
+    const double seconds = run_all(cmds, jobs);
+    std::cout << "  " << mode.name << ": " << seconds * 1000 << " ms";
+    if (mode.setup) std::cout << " + " << mode.setup * 1000 << " ms setup";
+    std::cout << "\n";
+    time_report(cmds[0]);
+  }
+  return 0;
+}
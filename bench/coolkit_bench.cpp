@@ -0,0 +1,452 @@
+// Microbenchmarks for the coolkit hot paths.
+//
+// usage: coolkit_bench [filter] [min_time_seconds]
+// Configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+
+#include <fcntl.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <forward_list>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+#include "bench.h"
+#include "coolkit/ansi.h"
+#include "coolkit/chunked_print.h"
+#include "coolkit/enum.h"
+#include "coolkit/erased_print.h"
+#include "coolkit/fdbuf.h"
+#include "coolkit/memstat.h"
+#include "coolkit/memstat_slack.h"
+#include "coolkit/memstat_tree.h"
+#include "coolkit/memstat_watch.h"
+#include "coolkit/pprint.h"
+#include "coolkit/screen.h"
+
+DEFINE_ENUM_CLASS(Color, red, green, blue, cyan, magenta, yellow, black,
+                  white);
+
+struct Record {
+  std::string name;
+  int age;
+  std::vector<std::string> tags;
+  INLINE_PRINT(Record, name, age, tags);
+};
+MEMSTAT_STRUCT(Record, name, age, tags);
+
+// a node of a pointer graph: peer pairs form cycles, head is shared by
+// every node of a group of 1024; in a list, peer is the next node
+struct GraphNode {
+  int id;
+  const GraphNode* peer;
+  const GraphNode* head;
+  INLINE_PRINT(GraphNode, id, peer, head);
+};
+
+namespace {
+
+// per-enumerator transition, as a protocol state machine would specialize
+template <Color C>
+unsigned step(unsigned state) {
+  return state * 31 + unsigned(C) * (unsigned(C) + 1);
+}
+
+unsigned step_switch(Color c, unsigned state) {
+  switch (c) {
+    case Color::red: return step<Color::red>(state);
+    case Color::green: return step<Color::green>(state);
+    case Color::blue: return step<Color::blue>(state);
+    case Color::cyan: return step<Color::cyan>(state);
+    case Color::magenta: return step<Color::magenta>(state);
+    case Color::yellow: return step<Color::yellow>(state);
+    case Color::black: return step<Color::black>(state);
+    case Color::white: return step<Color::white>(state);
+  }
+  return state;
+}
+
+std::vector<int> make_ints(size_t n) {
+  std::vector<int> vec(n);
+  for (size_t i = 0; i < n; ++i) vec[i] = int(i * 7919 % 100003);
+  return vec;
+}
+
+std::vector<std::string> make_strings(size_t n) {
+  std::vector<std::string> vec;
+  for (size_t i = 0; i < n; ++i)
+    vec.push_back("string-value-" + std::to_string(i));
+  return vec;
+}
+
+std::vector<Record> make_records(size_t n) {
+  std::vector<Record> vec;
+  for (size_t i = 0; i < n; ++i)
+    vec.push_back({"name" + std::to_string(i), int(i), {"reading", "coding"}});
+  return vec;
+}
+
+// Renders through print_impl with explicit color/multiline settings
+template <typename T>
+void render(std::ostream& os, const T& val, bool colors, bool memstat) {
+  PrintContext ctx{os};
+  ctx.colors = colors;
+  ctx.memstat = memstat;
+  print_impl(ctx, val);
+}
+
+template <typename T>
+void bench_print(const bench::Runner& runner, const std::string& name,
+                 const T& val) {
+  bench::NullBuf null;
+  std::ostream nullos{&null};
+
+  runner.run("stringify/" + name, [&] {
+    bench::do_not_optimize(stringify(val));
+  });
+  runner.run("stringify_erased/" + name, [&] {
+    bench::do_not_optimize(stringify_erased(val));
+  });
+  runner.run("print/plain/" + name, [&] { render(nullos, val, false, false); });
+  runner.run("print/color/" + name, [&] { render(nullos, val, true, false); });
+  runner.run("print/memstat/" + name,
+             [&] { render(nullos, val, false, true); });
+  PrintOptions width80;
+  width80.colors = false;
+  width80.memstat = false;
+  width80.width = 80;
+  runner.run("print/width80/" + name, [&] { print(nullos, val, width80); });
+
+  // the runner reports through stdio, so only the iostreams are redirected
+  std::streambuf* out = std::cout.rdbuf(&null);
+  std::streambuf* err = std::cerr.rdbuf(&null);
+  runner.run("printout/" + name, [&] { printout(val); });
+  runner.run("printerr/" + name, [&] { printerr(val); });
+  std::cout.rdbuf(out);
+  std::cerr.rdbuf(err);
+}
+
+template <typename T>
+void bench_memstat(const bench::Runner& runner, const std::string& name,
+                   const T& val) {
+  runner.run("memstat/" + name,
+             [&] { bench::do_not_optimize(memstat(val).nbytes); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bench::Runner runner;
+  if (argc > 1) runner.filter = argv[1];
+  if (argc > 2) runner.min_time = std::atof(argv[2]);
+  bench::Runner::header();
+
+  const auto ints = make_ints(1000);
+  const auto strings = make_strings(1000);
+  const auto records = make_records(100);
+  std::vector<std::vector<int>> nested(100, make_ints(10));
+  std::map<int, std::string> map;
+  std::unordered_map<int, std::string> umap;
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = strings[i];
+    umap[i] = strings[i];
+  }
+
+  // pretty printing
+  bench_print(runner, "vector<int>[1000]", ints);
+  bench_print(runner, "vector<string>[1000]", strings);
+  bench_print(runner, "vector<vector<int>>[100x10]", nested);
+  bench_print(runner, "map<int,string>[1000]", map);
+  bench_print(runner, "vector<Record>[100]", records);
+  std::vector<uint8_t> blob(4096);
+  for (size_t i = 0; i < blob.size(); ++i) blob[i] = uint8_t(i * 31);
+  bench_print(runner, "vector<uint8_t>[4096]", blob);
+
+  // numeric summary: one statistics pass, head and tail formatted
+  {
+    bench::NullBuf null;
+    std::ostream nullos{&null};
+    std::vector<double> samples(1 << 20);
+    for (size_t i = 0; i < samples.size(); ++i) samples[i] = double(i % 977);
+    PrintOptions summary;
+    summary.colors = false;
+    summary.memstat = false;
+    summary.summarize = 1000;
+    runner.run("summary/vector<double>[1M]",
+               [&] { print(nullos, samples, summary); });
+    runner.run("print/plain/vector<double>[1M]",
+               [&] { render(nullos, samples, false, false); });
+  }
+
+  // run-length collapsing: a sparse buffer, one nonzero per 4096 elements
+  {
+    bench::NullBuf null;
+    std::ostream nullos{&null};
+    std::vector<int> sparse(1 << 20);
+    for (size_t i = 0; i < sparse.size(); i += 4096) sparse[i] = 1;
+    PrintOptions collapse;
+    collapse.colors = false;
+    collapse.memstat = false;
+    collapse.collapse = 4;
+    runner.run("collapse/vector<int>[1M]",
+               [&] { print(nullos, sparse, collapse); });
+    runner.run("print/plain/sparse/vector<int>[1M]",
+               [&] { render(nullos, sparse, false, false); });
+    PrintOptions plain = collapse;
+    plain.collapse = 0;
+    if (runner.enabled("collapse/vector<int>[1M]"))
+      std::printf("%-44s %14zu %12zu bytes\n", "collapse/output vs plain",
+                  stringify(sparse, collapse).size(),
+                  stringify(sparse, plain).size());
+  }
+
+  // colored output post-processing
+  {
+    std::string colored;
+    while (colored.size() < (1 << 20)) colored += stringify(records);
+    const auto strip_gbps = runner.run("ansi/strip/1MiB", [&] {
+      bench::do_not_optimize(ansi::strip(colored));
+    });
+    bench::Runner::throughput("ansi/strip/1MiB", strip_gbps, colored.size());
+    const auto width_gbps = runner.run("ansi/visible_width/1MiB", [&] {
+      bench::do_not_optimize(ansi::visible_width(colored));
+    });
+    bench::Runner::throughput("ansi/visible_width/1MiB", width_gbps,
+                              colored.size());
+    const std::regex csi{"\x1b\\[[0-9;]*[A-Za-z]"};
+    const auto regex_gbps = runner.run("ansi/regex_strip/1MiB", [&] {
+      bench::do_not_optimize(std::regex_replace(colored, csi, ""));
+    });
+    bench::Runner::throughput("ansi/regex_strip/1MiB", regex_gbps,
+                              colored.size());
+  }
+
+  // live view: full redraw vs diffed frame with one changed value
+  {
+    bench::NullBuf null;
+    std::ostream nullos{&null};
+    ansi::set_color_mode(nullos, ansi::ColorMode::truecolor);
+    Screen screen{40, 120};
+    std::map<int, std::string> stats(map.begin(), std::next(map.begin(), 30));
+    const auto frame = [&] {
+      screen.clear();
+      screen.show({0, 0, 40, 120}, stats);
+    };
+    runner.run("screen/full_redraw/map<int,string>[30]", [&] {
+      frame();
+      screen.invalidate();
+      screen.flush(nullos);
+    });
+    size_t n = 0;
+    runner.run("screen/diff/map<int,string>[30]", [&] {
+      stats[int(n % 30)] = std::to_string(n);
+      n++;
+      frame();
+      screen.flush(nullos);
+    });
+  }
+
+  // pointer graphs: both passes of follow_pointers, linear in the nodes
+  {
+    bench::NullBuf null;
+    std::ostream nullos{&null};
+    PrintOptions follow;
+    follow.colors = false;
+    follow.memstat = false;
+    follow.follow_pointers = true;
+    for (size_t n : {100000, 1000000}) {
+      std::vector<std::unique_ptr<GraphNode>> graph(n);
+      for (size_t i = 0; i < n; ++i)
+        graph[i] = std::make_unique<GraphNode>(GraphNode{int(i), nullptr,
+                                                         nullptr});
+      for (size_t i = 0; i < n; ++i) {
+        graph[i]->peer = graph[i ^ 1].get();
+        graph[i]->head = graph[i / 1024 * 1024].get();
+      }
+      const std::string name =
+          "pointers/graph[" + std::to_string(n / 1000) + "k]";
+      const auto res = runner.run(name, [&] { print(nullos, graph, follow); });
+      if (res.ns_per_op > 0)
+        std::printf("%-44s %14.1f ns/node\n", name.c_str(),
+                    res.ns_per_op / double(n));
+    }
+    // a linked list as deep as it is long, through peer
+    for (size_t n : {100000, 1000000}) {
+      std::vector<GraphNode> list(n);
+      for (size_t i = 0; i < n; ++i)
+        list[i] = {int(i), i + 1 < n ? &list[i + 1] : nullptr, nullptr};
+      const std::string name =
+          "pointers/list[" + std::to_string(n / 1000) + "k]";
+      const auto res =
+          runner.run(name, [&] { print(nullos, &list[0], follow); });
+      if (res.ns_per_op > 0)
+        std::printf("%-44s %14.1f ns/node\n", name.c_str(),
+                    res.ns_per_op / double(n));
+    }
+  }
+
+  // disabled sinks: eager stringify vs deferred rendering
+  std::ostream disabled{nullptr};
+  runner.run("disabled/stringify/vector<Record>[100]",
+             [&] { disabled << stringify(records); });
+  runner.run("disabled/lazy_print/vector<Record>[100]",
+             [&] { disabled << lazy_print(records); });
+
+  // large dumps: ofstream vs writev batching straight to the descriptor
+  {
+    const std::vector<std::string> payloads(100, std::string(64 * 1024, 'p'));
+    std::ofstream devnull_stream("/dev/null");
+    const int devnull_fd = open("/dev/null", O_WRONLY);
+    PrintOptions opts;
+    opts.colors = false;
+    opts.memstat = false;
+    runner.run("dump/ofstream/vector<string>[100x64K]", [&] {
+      render(devnull_stream, payloads, false, false);
+      devnull_stream.flush();
+    });
+    runner.run("dump/fdbuf/vector<string>[100x64K]",
+               [&] { print_fd(devnull_fd, payloads, opts); });
+    runner.run("dump/ofstream/vector<Record>[100]", [&] {
+      render(devnull_stream, records, false, false);
+      devnull_stream.flush();
+    });
+    runner.run("dump/fdbuf/vector<Record>[100]",
+               [&] { print_fd(devnull_fd, records, opts); });
+
+    // debug endpoint: whole-string stringify vs 64 KiB chunks; bytes/op is
+    // the memory each needs
+    const auto state = make_records(10000);
+    runner.run("dump/stringify/vector<Record>[10000]", [&] {
+      const std::string text = stringify(state, opts);
+      bench::do_not_optimize(write(devnull_fd, text.data(), text.size()));
+    });
+    runner.run("dump/chunked/vector<Record>[10000]", [&] {
+      ChunkedPrint chunks{state, opts};
+      while (auto chunk = chunks.next())
+        bench::do_not_optimize(write(devnull_fd, chunk->data(), chunk->size()));
+    });
+    close(devnull_fd);
+  }
+
+  // memstat on every container specialization
+  const std::string long_string(1000, 'x');
+  std::deque<std::string> deque(strings.begin(), strings.end());
+  std::list<std::string> list(strings.begin(), strings.end());
+  std::forward_list<std::string> flist(strings.begin(), strings.end());
+  std::set<std::string> set(strings.begin(), strings.end());
+  std::unordered_set<std::string> uset(strings.begin(), strings.end());
+  std::stack<std::string> stack(deque);
+  std::pair<std::string, std::vector<int>> pair{long_string, ints};
+  std::optional<std::vector<std::string>> opt{strings};
+  std::queue<std::string> queue(deque);
+  std::priority_queue<int> pqueue(ints.begin(), ints.end());
+  std::array<std::string, 16> array;
+  array.fill(long_string);
+  std::variant<int, std::string> variant{long_string};
+  const auto unique = std::make_unique<std::vector<int>>(ints);
+  // DAG: every owner points at one of 10 shared targets
+  std::vector<std::shared_ptr<std::string>> targets, shared;
+  for (int i = 0; i < 10; ++i)
+    targets.push_back(std::make_shared<std::string>(long_string));
+  for (int i = 0; i < 1000; ++i) shared.push_back(targets[i % 10]);
+
+  bench_memstat(runner, "string[1000]", long_string);
+  bench_memstat(runner, "vector<int>[1000]", ints);
+  bench_memstat(runner, "vector<string>[1000]", strings);
+  bench_memstat(runner, "deque<string>[1000]", deque);
+  bench_memstat(runner, "list<string>[1000]", list);
+  bench_memstat(runner, "forward_list<string>[1000]", flist);
+  bench_memstat(runner, "set<string>[1000]", set);
+  bench_memstat(runner, "unordered_set<string>[1000]", uset);
+  bench_memstat(runner, "map<int,string>[1000]", map);
+  bench_memstat(runner, "unordered_map<int,string>[1000]", umap);
+  bench_memstat(runner, "pair<string,vector<int>>", pair);
+  bench_memstat(runner, "optional<vector<string>>", opt);
+  bench_memstat(runner, "stack<string>[1000]", stack);
+  bench_memstat(runner, "queue<string>[1000]", queue);
+  bench_memstat(runner, "priority_queue<int>[1000]", pqueue);
+  bench_memstat(runner, "array<string,16>", array);
+  bench_memstat(runner, "variant<int,string>", variant);
+  bench_memstat(runner, "unique_ptr<vector<int>>", unique);
+  bench_memstat(runner, "vector<shared_ptr<string>>[1000/10]", shared);
+  bench_memstat(runner, "vector<Record>[100]", records);
+  // no pruning, so every record and field becomes a node
+  runner.run("memstat_tree/vector<Record>[100]", [&] {
+    bench::do_not_optimize(memstat_tree(records, {"records", 0, 0}));
+  });
+  runner.run("memstat_tree/shared[1000/10]", [&] {
+    bench::do_not_optimize(memstat_tree(shared, {"shared", 0, 0}));
+  });
+  runner.run("memstat_slack/vector<Record>[100]",
+             [&] { bench::do_not_optimize(memstat_slack(records)); });
+
+  // memstat watch: a tick samples a bounded share of the watched objects
+  {
+    const std::vector<std::vector<Record>> watched(1000, records);
+    for (const size_t per_tick : {size_t(16), watched.size()}) {
+      MemstatWatchOptions opts;
+      opts.objects_per_tick = per_tick;
+      MemstatWatcher watcher{opts};
+      std::vector<MemstatWatch> watches;
+      for (const auto& val : watched)
+        watches.push_back(watcher.watch("records", val));
+      runner.run("memstat_watch/tick[" + std::to_string(per_tick) + " of " +
+                     std::to_string(watched.size()) + "]",
+                 [&] { watcher.tick(); });
+    }
+  }
+
+  // ansi emission
+  bench::NullBuf null;
+  std::ostream nullos{&null};
+  runner.run("ansi/sgr", [&] { nullos << ansi::bold; });
+  runner.run("ansi/fg::rgb", [&] { nullos << ansi::fg::rgb(0x4EC9B0); });
+  runner.run("ansi/move", [&] { nullos << ansi::move(12, 40); });
+  runner.run("ansi/group", [&] {
+    bench::do_not_optimize(ansi::bold | ansi::underline | ansi::fg::red);
+  });
+
+  // enum names
+  runner.run("enum/string", [&] {
+    Enum<Color>::foreach (
+        [](Color c) { bench::do_not_optimize(Enum<Color>::string(c)); });
+  });
+
+  // enum dispatch: a state machine stepping through a fixed input
+  {
+    std::vector<Color> input(1024);
+    for (size_t i = 0; i < input.size(); ++i)
+      input[i] = Color(i * 7919 % Enum<Color>::size);
+    runner.run("enum/switch/1024", [&] {
+      unsigned state = 0;
+      for (const Color c : input) state = step_switch(c, state);
+      bench::do_not_optimize(state);
+    });
+    runner.run("enum/visit/1024", [&] {
+      unsigned state = 0;
+      for (const Color c : input) {
+        state = Enum<Color>::visit(
+            c, [&](auto color) { return step<color()>(state); });
+      }
+      bench::do_not_optimize(state);
+    });
+  }
+
+  return 0;
+}
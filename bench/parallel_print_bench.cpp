@@ -0,0 +1,110 @@
+// Scaling of print_parallel over the number of threads.
+//
+// Renders a vector of records with stringify and with stringify_parallel
+// on pools of 1, 2, 4, ... threads up to the hardware concurrency, checks
+// that the outputs match and reports the speedup. Before that, runs many
+// small batches back to back and checks that every task ran once, with the
+// function of its own batch.
+//
+// usage: coolkit_parallel_bench [records] [repetitions]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coolkit/memstat.h"
+#include "coolkit/parallel_print.h"
+#include "coolkit/pprint.h"
+
+struct Person {
+  std::string name;
+  int age;
+  std::vector<std::string> hobbies;
+  INLINE_PRINT(Person, name, age, hobbies);
+};
+MEMSTAT_STRUCT(Person, name, age, hobbies);
+
+namespace {
+
+template <typename F>
+double best_of(int repetitions, F&& f) {
+  double best = 1e300;
+  for (int i = 0; i < repetitions; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto stop = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(stop - start).count());
+  }
+  return best;
+}
+
+// Each batch counts its tasks in its own array, destroyed when run()
+// returns, so a task of one batch given to another shows up as a miscount
+bool back_to_back(WorkStealingPool& pool, int batches) {
+  for (int batch = 0; batch < batches; ++batch) {
+    const size_t count = 1 + size_t(batch) % (2 * pool.size());
+    std::vector<std::atomic<int>> runs(count);
+    std::atomic<int> foreign{0};
+    pool.run(count, [&, batch](size_t i) {
+      if (i >= count) foreign++;
+      else runs[i]++;
+      if (batch % 7 == 0) std::this_thread::yield();
+    });
+    const auto once = [](const std::atomic<int>& n) { return n == 1; };
+    if (foreign || !std::all_of(runs.begin(), runs.end(), once)) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? size_t(std::atol(argv[1])) : 1000000;
+  const int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+  std::vector<Person> people(n);
+  for (size_t i = 0; i < n; ++i) {
+    people[i] = {"person" + std::to_string(i), int(i % 100), {}};
+    for (size_t j = 0; j < i % 4; ++j) people[i].hobbies.push_back("hobby");
+  }
+
+  {
+    const size_t threads =
+        std::max<size_t>(std::thread::hardware_concurrency(), 4);
+    WorkStealingPool pool{threads - 1};
+    if (!back_to_back(pool, 100000)) {
+      std::printf("a task of one batch ran in another\n");
+      return 1;
+    }
+  }
+
+  const std::string expected = stringify(people);
+  const double serial =
+      best_of(repetitions, [&] { std::string out = stringify(people); });
+  std::printf("%zu records, %zu bytes of output\n", n, expected.size());
+  std::printf("%-10s %12s %10s\n", "threads", "ms", "speedup");
+  std::printf("%-10s %12.1f %10.2f\n", "serial", serial * 1000, 1.0);
+
+  // at least 4, so small machines still check the chunked output
+  const size_t max_threads =
+      std::max<size_t>(std::thread::hardware_concurrency(), 4);
+  for (size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    WorkStealingPool pool{threads - 1};
+    std::string out;
+    const double seconds = best_of(repetitions, [&] {
+      out = stringify_parallel(people, {}, pool, 0);
+    });
+    if (out != expected) {
+      std::printf("output of %zu threads differs from stringify\n", threads);
+      return 1;
+    }
+    std::printf("%-10zu %12.1f %10.2f\n", threads, seconds * 1000,
+                serial / seconds);
+    if (threads == max_threads) break;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Preprocessor/compile-time benchmark for the reflection macros.
+//
+// Generates a translation unit with N annotated structs (ENUM, INLINE_PRINT,
+// PRINT_STRUCT, INLINE_MEMSTAT, MEMSTAT_STRUCT) and times the compiler on it
+// with the arity-dispatched PP_FOREACH and with the recursive fallback.
+// Fails if either expansion does not compile the generated code.
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifndef COOLKIT_BENCH_CXX
+#define COOLKIT_BENCH_CXX "c++"
+#endif
+#ifndef COOLKIT_BENCH_INCLUDE
+#define COOLKIT_BENCH_INCLUDE "include"
+#endif
+
+static void generate(const std::string& path, int nstructs) {
+  static const char* field_types[] = {"std::string", "int",
+                                      "std::vector<int>"};
+  std::ofstream out(path);
+  out << "#include <string>\n#include <vector>\n"
+      << "#include \"coolkit/enum.h\"\n#include \"coolkit/pprint.h\"\n\n";
+  // a trailing comma adds no element, in both expansions
+  out << "#define PP_BENCH_ONE(x) 1\n"
+      << "constexpr int trailing[] = {PP_FOREACH_LIST(PP_BENCH_ONE, a, b, )};\n"
+      << "static_assert(sizeof(trailing) == 2 * sizeof(int));\n"
+      << "DEFINE_ENUM_CLASS(Trailing, red, green, blue, );\n\n";
+  for (int i = 0; i < nstructs; ++i) {
+    const int nfields = 2 + i % 7;
+    std::string fields;
+    for (int f = 0; f < nfields; ++f) fields += ", f" + std::to_string(f);
+
+    out << "enum struct E" << i << " { a, b, c, d };\n"
+        << "ENUM(E" << i << ", a, b, c, d)\n";
+    out << "struct S" << i << " {\n";
+    for (int f = 0; f < nfields; ++f)
+      out << "  " << field_types[f % 3] << " f" << f << ";\n";
+    out << "  INLINE_PRINT(S" << i << fields << ");\n"
+        << "  INLINE_MEMSTAT(S" << i << fields << ");\n};\n";
+    out << "struct T" << i << " {\n";
+    for (int f = 0; f < nfields; ++f) out << "  int f" << f << ";\n";
+    out << "};\n"
+        << "PRINT_STRUCT(T" << i << fields << ");\n"
+        << "MEMSTAT_STRUCT(T" << i << fields << ");\n\n";
+  }
+}
+
+static double run(const std::string& cmd) {
+  const auto start = std::chrono::steady_clock::now();
+  if (std::system(cmd.c_str()) != 0) {
+    std::cerr << "command failed: " << cmd << "\n";
+    std::exit(1);
+  }
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(stop - start).count();
+}
+
+int main(int argc, char** argv) {
+  const int nstructs = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const std::string src = "pp_bench_generated.cpp";
+  generate(src, nstructs);
+
+  const std::string base = std::string(COOLKIT_BENCH_CXX) +
+                           " -std=c++17 -I" COOLKIT_BENCH_INCLUDE " " + src;
+  struct Mode {
+    const char* name;
+    const char* flags;
+  } modes[] = {
+      {"arity", ""},
+      {"recursive", " -DPP_FOREACH_NO_ARITY_DISPATCH"},
+  };
+
+  std::cout << nstructs << " structs\n";
+  for (const auto& mode : modes) {
+    const double pp = run(base + mode.flags + " -E -o /dev/null");
+    const double syntax = run(base + mode.flags + " -fsyntax-only");
+    std::cout << "  " << mode.name << ": preprocess " << pp * 1000
+              << " ms, syntax-only " << syntax * 1000 << " ms\n";
+  }
+  return 0;
+}
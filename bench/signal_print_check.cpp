@@ -0,0 +1,137 @@
+// Checks that SignalPrinter renders without allocating: state is printed
+// from a signal handler while malloc and operator new abort the program.
+//
+// usage: coolkit_signal_check
+// Exits with 0 and prints the dump on success.
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "coolkit/signal_print.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+
+std::atomic<bool> poisoned{false};
+
+void check_poison(const char* what) {
+  if (!poisoned.load(std::memory_order_relaxed)) return;
+  const char msg[] = "allocation in signal handler: ";
+  ::write(STDERR_FILENO, msg, sizeof(msg) - 1);
+  ::write(STDERR_FILENO, what, std::strlen(what));
+  ::write(STDERR_FILENO, "\n", 1);
+  ::_exit(1);
+}
+
+}  // namespace
+
+extern "C" {
+void* malloc(size_t size) {
+  check_poison("malloc");
+  return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+  check_poison("calloc");
+  return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+  check_poison("realloc");
+  return __libc_realloc(ptr, size);
+}
+void free(void* ptr) {
+  check_poison("free");
+  __libc_free(ptr);
+}
+}
+
+void* operator new(size_t size) {
+  check_poison("operator new");
+  if (void* ptr = __libc_malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc{};
+}
+void* operator new[](size_t size) { return ::operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+struct Request {
+  std::string path;
+  int status;
+  double latency;
+  std::vector<std::string> headers;
+  INLINE_PRINT(Request, path, status, latency, headers);
+};
+
+struct Unprintable {
+  int x;
+};
+
+namespace {
+
+char dump_buffer[4096];
+char small_buffer[48];
+SignalPrinter* dump;
+SignalPrinter* small;
+std::map<int, Request>* requests;
+const std::vector<int>* numbers;
+const std::string* long_text;
+bool ok = true;
+
+void on_signal(int) {
+  poisoned = true;
+  dump->write("crash dump:\n");
+  ok &= dump->print(*requests);
+  ok &= dump->print(std::make_tuple(1e300, -0.0, 42u, 'x', "text"));
+  ok &= dump->print(Unprintable{1});
+  // cut output ends in the mark
+  ok &= small->print(*numbers);
+  ok &= small->truncated();
+  ok &= small->format(*long_text).size() <= sizeof(small_buffer);
+  poisoned = false;
+}
+
+}  // namespace
+
+int main() {
+  std::map<int, Request> state;
+  state[1] = {"/index.html", 200, 0.0125, {"Host: example.com"}};
+  state[2] = {"/api/\"quoted\"", 404, 1.5e-6, {}};
+  requests = &state;
+  const std::vector<int> ints(1000, 7);
+  numbers = &ints;
+  const std::string text(1000, 'x');
+  long_text = &text;
+
+  PrintOptions opts;
+  opts.colors = false;
+  opts.quotes = true;
+  SignalPrinter dump_printer{STDOUT_FILENO, dump_buffer, sizeof(dump_buffer),
+                             opts};
+  SignalPrinter small_printer{STDOUT_FILENO, small_buffer,
+                              sizeof(small_buffer), opts};
+  dump = &dump_printer;
+  small = &small_printer;
+
+  struct sigaction action {};
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR1, &action, nullptr);
+  raise(SIGUSR1);
+
+  dump_printer.write(ok ? "ok\n" : "failed\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// Code size of printing many distinct types, templated vs type-erased.
+//
+// Generates one translation unit that stringifies N distinct container
+// types with stringify() and one with stringify_erased(), compiles both
+// with -O2 and reports the size of their code sections. The speed of both
+// paths is part of coolkit_bench (stringify_erased/...).
+//
+// usage: coolkit_size_bench [ntypes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef COOLKIT_BENCH_CXX
+#define COOLKIT_BENCH_CXX "c++"
+#endif
+#ifndef COOLKIT_BENCH_INCLUDE
+#define COOLKIT_BENCH_INCLUDE "include"
+#endif
+
+static const char* dir = "size_bench";
+
+// container<leaf> and container<container<leaf>> combinations
+static std::vector<std::string> make_types(size_t count) {
+  const char* leaves[] = {"int",   "double", "std::string", "long",
+                          "float", "short",  "unsigned",    "bool"};
+  const char* wrappers[] = {"std::vector<%>",      "std::list<%>",
+                            "std::deque<%>",       "std::map<int, %>",
+                            "std::optional<%>",    "std::pair<int, %>",
+                            "std::tuple<char, %>", "std::map<std::string, %>"};
+  std::vector<std::string> types;
+  const auto wrap = [](std::string wrapper, const std::string& inner) {
+    return wrapper.replace(wrapper.find('%'), 1, inner);
+  };
+  for (const char* outer : wrappers)
+    for (const char* inner : wrappers)
+      for (const char* leaf : leaves) {
+        if (types.size() == count) return types;
+        types.push_back(wrap(outer, wrap(inner, leaf)));
+      }
+  return types;
+}
+
+static void generate(const std::string& path, const char* function,
+                     const std::vector<std::string>& types) {
+  std::ofstream out(path);
+  out << "#include <deque>\n#include <list>\n#include <map>\n"
+      << "#include <optional>\n#include <string>\n#include <tuple>\n"
+      << "#include <vector>\n#include \"coolkit/erased_print.h\"\n\n";
+  for (size_t i = 0; i < types.size(); ++i)
+    out << "std::string print" << i << "(const " << types[i]
+        << "& val) { return " << function << "(val); }\n";
+}
+
+static bool run(const std::string& cmd) {
+  if (std::system(cmd.c_str()) == 0) return true;
+  std::cerr << "command failed: " << cmd << "\n";
+  return false;
+}
+
+// bytes in the .text sections of an object file
+static size_t text_size(const std::string& object) {
+  const std::string report = object + ".size";
+  if (!run("size -A " + object + " > " + report)) std::exit(1);
+  std::ifstream in(report);
+  size_t total = 0;
+  for (std::string line; std::getline(in, line);) {
+    std::istringstream fields(line);
+    std::string section;
+    size_t size;
+    if (fields >> section >> size && section.rfind(".text", 0) == 0)
+      total += size;
+  }
+  return total;
+}
+
+int main(int argc, char** argv) {
+  const size_t ntypes = argc > 1 ? size_t(std::atol(argv[1])) : 64;
+  const auto types = make_types(ntypes);
+  if (!run(std::string("mkdir -p ") + dir)) return 1;
+  const std::string cxx = std::string(COOLKIT_BENCH_CXX) +
+                          " -std=c++17 -O2 -I" COOLKIT_BENCH_INCLUDE;
+  std::cout << types.size() << " types\n";
+
+  size_t sizes[2];
+  const char* functions[] = {"stringify", "stringify_erased"};
+  for (int i = 0; i < 2; ++i) {
+    const std::string source = std::string(dir) + "/" + functions[i];
+    generate(source + ".cpp", functions[i], types);
+    if (!run(cxx + " -c " + source + ".cpp -o " + source + ".o")) return 1;
+    sizes[i] = text_size(source + ".o");
+    std::printf("  %-18s %10zu bytes of code, %8zu per type\n", functions[i],
+                sizes[i], sizes[i] / types.size());
+  }
+  std::printf("  erased/templated   %10.2f\n", double(sizes[1]) / sizes[0]);
+  return 0;
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "memstat.h"
+#include "pprint.h"
+
+// Live allocation tracking by tag, as ground truth for memstat estimates.
+//
+// Allocations are attributed to the tag of the innermost AllocScope on the
+// allocating thread ("untagged" outside of scopes). Counters are per thread
+// and updated without locks or read-modify-write instructions; reports sum
+// them over all threads.
+//
+// Two sources feed the counters:
+//  - TrackedAllocator<T, Tag>, a standard allocator that counts under the
+//    type tag of Tag, for individual containers
+//  - global operator new/delete, replaced in the translation unit that
+//    defines COOLKIT_ALLOC_TRACK_NEW before including this header (exactly
+//    one per program); each block then carries a 16 byte header with its
+//    size and tag
+
+static constexpr uint32_t alloc_max_tags = 64;
+
+struct AllocTag {
+  uint32_t index = 0;
+};
+
+// Counters of one thread; blocks of exited threads are reused, so their
+// counts are kept
+struct AllocCounters {
+  std::atomic<int64_t> bytes[alloc_max_tags];   // live bytes
+  std::atomic<int64_t> blocks[alloc_max_tags];  // live allocations
+  std::atomic<uint64_t> allocs[alloc_max_tags];
+  std::atomic<bool> in_use{true};
+  AllocCounters* next = nullptr;
+
+  // single writer: plain load and store instead of a locked add
+  template <typename C, typename V>
+  static void bump(C& counter, V delta) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta,
+                  std::memory_order_relaxed);
+  }
+
+  void add(uint32_t tag, size_t size) {
+    bump(bytes[tag], int64_t(size));
+    bump(blocks[tag], int64_t(1));
+    bump(allocs[tag], uint64_t(1));
+  }
+
+  void remove(uint32_t tag, size_t size) {
+    bump(bytes[tag], -int64_t(size));
+    bump(blocks[tag], int64_t(-1));
+  }
+};
+
+class AllocTracker {
+  inline static std::atomic<AllocCounters*> head{nullptr};
+  // used with atomic adds once a thread's block is released
+  inline static AllocCounters shared{};
+  inline static thread_local AllocCounters* local = nullptr;
+  inline static thread_local bool exiting = false;
+  inline static thread_local AllocTag current{};
+
+  struct Release {
+    ~Release() {
+      exiting = true;
+      if (local) local->in_use.store(false, std::memory_order_release);
+      local = nullptr;
+    }
+  };
+
+  // Takes a released block or links a new one; allocated with malloc, so
+  // it does not recurse into a replaced operator new
+  static AllocCounters* acquire() {
+    for (AllocCounters* it = head.load(std::memory_order_acquire); it;
+         it = it->next) {
+      bool in_use = false;
+      if (it->in_use.compare_exchange_strong(in_use, true)) return it;
+    }
+    void* mem = std::malloc(sizeof(AllocCounters));
+    if (!mem) return nullptr;
+    auto* counters = new (mem) AllocCounters{};
+    counters->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(counters->next, counters)) {
+    }
+    return counters;
+  }
+
+  static AllocCounters* counters() {
+    if (local) return local;
+    if (exiting) return nullptr;
+    local = acquire();
+    static thread_local Release release;
+    return local;
+  }
+
+  friend class AllocScope;
+
+ public:
+  static AllocTag tag() { return current; }
+
+  static void add(AllocTag tag, size_t size) {
+    if (AllocCounters* c = counters()) return c->add(tag.index, size);
+    shared.bytes[tag.index].fetch_add(int64_t(size));
+    shared.blocks[tag.index].fetch_add(1);
+    shared.allocs[tag.index].fetch_add(1);
+  }
+
+  static void remove(AllocTag tag, size_t size) {
+    if (AllocCounters* c = counters()) return c->remove(tag.index, size);
+    shared.bytes[tag.index].fetch_sub(int64_t(size));
+    shared.blocks[tag.index].fetch_sub(1);
+  }
+
+  // Calls f(counters) for the shared block and every thread block
+  template <typename F>
+  static void foreach_counters(F&& f) {
+    f(shared);
+    for (AllocCounters* it = head.load(std::memory_order_acquire); it;
+         it = it->next)
+      f(*it);
+  }
+};
+
+// Tag names, registered once per name; registering takes a lock, counting
+// does not
+class AllocTagRegistry {
+  std::mutex mutex;
+  std::string names[alloc_max_tags] = {"untagged"};
+  uint32_t count = 1;
+
+ public:
+  static AllocTagRegistry& instance() {
+    static AllocTagRegistry registry;
+    return registry;
+  }
+
+  // Tag for name; tags past alloc_max_tags fall back to "untagged"
+  AllocTag get(const std::string& name) {
+    const std::lock_guard<std::mutex> lock{mutex};
+    for (uint32_t i = 0; i < count; ++i)
+      if (names[i] == name) return {i};
+    if (count == alloc_max_tags) return {0};
+    names[count] = name;
+    return {count++};
+  }
+
+  uint32_t size() {
+    const std::lock_guard<std::mutex> lock{mutex};
+    return count;
+  }
+
+  // names are never changed once registered
+  const char* name(AllocTag tag) const { return names[tag.index].c_str(); }
+};
+
+inline AllocTag alloc_tag(const std::string& name) {
+  return AllocTagRegistry::instance().get(name);
+}
+
+template <typename T>
+AllocTag alloc_tag_of() {
+  static const AllocTag tag = alloc_tag(get_typename<T>());
+  return tag;
+}
+
+// Attributes allocations of this thread to tag until the end of the scope
+class AllocScope {
+  AllocTag saved;
+
+ public:
+  explicit AllocScope(AllocTag tag) : saved(AllocTracker::current) {
+    AllocTracker::current = tag;
+  }
+  explicit AllocScope(const std::string& name) : AllocScope(alloc_tag(name)) {}
+  ~AllocScope() { AllocTracker::current = saved; }
+  AllocScope(const AllocScope&) = delete;
+  AllocScope& operator=(const AllocScope&) = delete;
+};
+
+// Standard allocator counting under the type tag of Tag, e.g.
+// std::vector<Record, TrackedAllocator<Record>>
+template <typename T, typename Tag = T>
+struct TrackedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = TrackedAllocator<U, Tag>;
+  };
+
+  TrackedAllocator() = default;
+  template <typename U>
+  TrackedAllocator(const TrackedAllocator<U, Tag>&) {}
+
+  T* allocate(size_t n) {
+    constexpr size_t align = alignof(T);
+    const size_t size = n * sizeof(T);
+    const size_t rounded = std::max((size + align - 1) / align * align, align);
+    void* ptr = align > alignof(std::max_align_t)
+                    ? std::aligned_alloc(align, rounded)
+                    : std::malloc(rounded);
+    if (!ptr) throw std::bad_alloc{};
+    AllocTracker::add(alloc_tag_of<Tag>(), size);
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    AllocTracker::remove(alloc_tag_of<Tag>(), n * sizeof(T));
+    std::free(ptr);
+  }
+
+  template <typename U>
+  bool operator==(const TrackedAllocator<U, Tag>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const TrackedAllocator<U, Tag>&) const {
+    return false;
+  }
+};
+
+// report
+
+struct AllocStat {
+  const char* tag;
+  Memsize live;
+  int64_t blocks;   // live allocations
+  uint64_t allocs;  // allocations so far
+  INLINE_PRINT(AllocStat, tag, live, blocks, allocs);
+};
+
+template <>
+struct is_memstattable<AllocStat> : std::false_type {};
+
+// Counters of one tag summed over all threads
+inline AllocStat alloc_stat(AllocTag tag) {
+  AllocStat stat{AllocTagRegistry::instance().name(tag), Memsize{0}, 0, 0};
+  int64_t bytes = 0;
+  AllocTracker::foreach_counters([&](const AllocCounters& c) {
+    bytes += c.bytes[tag.index].load(std::memory_order_relaxed);
+    stat.blocks += c.blocks[tag.index].load(std::memory_order_relaxed);
+    stat.allocs += c.allocs[tag.index].load(std::memory_order_relaxed);
+  });
+  // blocks freed by a thread other than the allocating one are subtracted
+  // there, so only the sum is meaningful
+  stat.live = Memsize{size_t(std::max<int64_t>(bytes, 0))};
+  return stat;
+}
+
+// Every tag with allocations, largest live size first
+inline std::vector<AllocStat> alloc_stats() {
+  std::vector<AllocStat> stats;
+  const uint32_t count = AllocTagRegistry::instance().size();
+  for (uint32_t i = 0; i < count; ++i) {
+    const AllocStat stat = alloc_stat({i});
+    if (stat.allocs) stats.push_back(stat);
+  }
+  std::stable_sort(stats.begin(), stats.end(),
+                   [](const AllocStat& a, const AllocStat& b) {
+                     return a.live.nbytes > b.live.nbytes;
+                   });
+  return stats;
+}
+
+// Live bytes tracked under a tag next to the heap part of memstat(val)
+struct AllocCheck {
+  const char* tag;
+  Memsize tracked;
+  Memsize estimated;
+  INLINE_PRINT(AllocCheck, tag, tracked, estimated);
+};
+
+template <>
+struct is_memstattable<AllocCheck> : std::false_type {};
+
+template <typename T>
+AllocCheck alloc_check(AllocTag tag, const T& val) {
+  const AllocStat stat = alloc_stat(tag);
+  return {stat.tag, stat.live, Memsize{::memstat(val).nbytes - sizeof(T)}};
+}
+
+#ifdef COOLKIT_ALLOC_TRACK_NEW
+
+namespace alloc_track {
+
+// size and tag in front of every block
+struct alignas(16) Header {
+  size_t size;
+  AllocTag tag;
+};
+
+inline void* allocate(size_t size, size_t align) {
+  const size_t offset = std::max(sizeof(Header), align);
+  void* base = align > alignof(std::max_align_t)
+                   ? std::aligned_alloc(align, (offset + size + align - 1) /
+                                                   align * align)
+                   : std::malloc(offset + size);
+  if (!base) throw std::bad_alloc{};
+  char* ptr = static_cast<char*>(base) + offset;
+  const AllocTag tag = AllocTracker::tag();
+  new (ptr - sizeof(Header)) Header{size, tag};
+  AllocTracker::add(tag, size);
+  return ptr;
+}
+
+inline void deallocate(void* ptr, size_t align) {
+  if (!ptr) return;
+  const size_t offset = std::max(sizeof(Header), align);
+  const auto* header = reinterpret_cast<const Header*>(
+      static_cast<char*>(ptr) - sizeof(Header));
+  AllocTracker::remove(header->tag, header->size);
+  std::free(static_cast<char*>(ptr) - offset);
+}
+
+}  // namespace alloc_track
+
+void* operator new(size_t size) { return alloc_track::allocate(size, 0); }
+void* operator new[](size_t size) { return alloc_track::allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t align) {
+  return alloc_track::allocate(size, size_t(align));
+}
+void* operator new[](size_t size, std::align_val_t align) {
+  return alloc_track::allocate(size, size_t(align));
+}
+void operator delete(void* ptr) noexcept { alloc_track::deallocate(ptr, 0); }
+void operator delete[](void* ptr) noexcept { alloc_track::deallocate(ptr, 0); }
+void operator delete(void* ptr, size_t) noexcept {
+  alloc_track::deallocate(ptr, 0);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+  alloc_track::deallocate(ptr, 0);
+}
+void operator delete(void* ptr, std::align_val_t align) noexcept {
+  alloc_track::deallocate(ptr, size_t(align));
+}
+void operator delete[](void* ptr, std::align_val_t align) noexcept {
+  alloc_track::deallocate(ptr, size_t(align));
+}
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept {
+  alloc_track::deallocate(ptr, size_t(align));
+}
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept {
+  alloc_track::deallocate(ptr, size_t(align));
+}
+
+#endif
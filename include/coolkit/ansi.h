@@ -1,8 +1,20 @@
 #pragma once
 
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 #include <ostream>
 #include <sstream>
+#include <string>
+#include <string_view>
 
 namespace ansi {
 
@@ -36,15 +48,39 @@ struct Ansi {
   char command;
   uint16_t nargs;
   std::array<int, 5> args;
+
+  // longest possible sequence: ESC, code, 5 args with separators, command
+  static constexpr size_t max_size = 2 + 5 * 12 + 1;
+
+  // Writes the sequence into out (at least max_size chars) and returns its
+  // length; usable in constant expressions
+  constexpr size_t format(char *out) const {
+    size_t len = 0;
+    out[len++] = '\e';
+    out[len++] = code;
+    for (int i = 0; i < nargs; ++i) {
+      if (i) out[len++] = ';';
+      long value = args[i];
+      if (value < 0) {
+        out[len++] = '-';
+        value = -value;
+      }
+      char digits[11]{};
+      int ndigits = 0;
+      do {
+        digits[ndigits++] = char('0' + value % 10);
+        value /= 10;
+      } while (value);
+      while (ndigits) out[len++] = digits[--ndigits];
+    }
+    out[len++] = command;
+    return len;
+  }
 };
 
 inline std::ostream &operator<<(std::ostream &os, const ansi::Ansi &a) {
-  os << '\e' << a.code;
-  for (int i = 0; i < a.nargs; ++i) {
-    if (i) os << ";";
-    os << a.args[i];
-  }
-  return os << a.command;
+  char buf[Ansi::max_size];
+  return os.write(buf, a.format(buf));
 }
 
 struct AnsiGroup {
@@ -201,7 +237,7 @@ constexpr auto bright_cyan    = SGR{bright_base + color::cyan};
 constexpr auto bright_white   = SGR{bright_base + color::white};
 // clang-format on
 
-constexpr auto c8bit(int value) { return SGR{base + color::set, value}; }
+constexpr auto c8bit(int value) { return SGR{base + color::set, 5, value}; }
 constexpr auto rgb(int r, int g, int b) {
   return SGR{base + color::set, 2, r, g, b};
 }
@@ -211,4 +247,307 @@ constexpr auto rgb(uint hex) {
 
 }  // namespace bg
 
+// color capabilities
+
+enum class ColorMode : uint8_t { none, basic, c256, truecolor };
+static constexpr size_t ncolor_modes = 4;
+
+namespace palette {
+
+struct Rgb {
+  int r, g, b;
+};
+
+// xterm-256: 16 basic colors, 6x6x6 cube, 24 grays
+constexpr std::array<Rgb, 16> basic{{
+    {0, 0, 0},       {205, 0, 0},     {0, 205, 0},   {205, 205, 0},
+    {0, 0, 238},     {205, 0, 205},   {0, 205, 205}, {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0},     {0, 255, 0},   {255, 255, 0},
+    {92, 92, 255},   {255, 0, 255},   {0, 255, 255}, {255, 255, 255},
+}};
+constexpr std::array<int, 6> cube_levels{0, 95, 135, 175, 215, 255};
+
+// nearest cube level for every channel value
+constexpr auto cube_index = [] {
+  std::array<uint8_t, 256> table{};
+  for (int v = 0; v < 256; ++v)
+    table[v] = v < 48 ? 0 : v < 115 ? 1 : uint8_t((v - 35) / 40);
+  return table;
+}();
+
+constexpr int distance(Rgb a, Rgb b) {
+  return (a.r - b.r) * (a.r - b.r) + (a.g - b.g) * (a.g - b.g) +
+         (a.b - b.b) * (a.b - b.b);
+}
+
+constexpr Rgb from_256(int index) {
+  if (index < 16) return basic[index];
+  if (index >= 232) {
+    const int v = 8 + (index - 232) * 10;
+    return {v, v, v};
+  }
+  index -= 16;
+  return {cube_levels[index / 36], cube_levels[index / 6 % 6],
+          cube_levels[index % 6]};
+}
+
+constexpr int to_256(Rgb c) {
+  const int ri = cube_index[c.r], gi = cube_index[c.g], bi = cube_index[c.b];
+  const int cube = 16 + 36 * ri + 6 * gi + bi;
+  const int avg = (c.r + c.g + c.b) / 3;
+  const int gray = 232 + (avg > 238 ? 23 : avg < 8 ? 0 : (avg - 3) / 10);
+  return distance(c, from_256(gray)) < distance(c, from_256(cube)) ? gray
+                                                                   : cube;
+}
+
+constexpr int to_16(Rgb c) {
+  int best = 0;
+  for (int i = 1; i < 16; ++i)
+    if (distance(c, basic[i]) < distance(c, basic[best])) best = i;
+  return best;
+}
+
+}  // namespace palette
+
+// Maps an extended fg/bg color SGR to what mode can show; other sequences
+// are returned as is
+constexpr Ansi downgrade(const Ansi &a, ColorMode mode) {
+  const bool extended = a.command == 'm' && a.nargs >= 3 &&
+                        (a.args[0] == fg::base + color::set ||
+                         a.args[0] == bg::base + color::set);
+  if (!extended || mode == ColorMode::truecolor) return a;
+  const bool is_fg = a.args[0] == fg::base + color::set;
+  const bool is_rgb = a.args[1] == 2 && a.nargs == 5;
+  const palette::Rgb rgb =
+      is_rgb ? palette::Rgb{a.args[2], a.args[3], a.args[4]}
+             : palette::from_256(a.args[2]);
+  if (mode == ColorMode::c256)
+    return is_rgb ? SGR{a.args[0], 5, palette::to_256(rgb)} : a;
+  const int index = palette::to_16(rgb);
+  const int base = index < 8 ? (is_fg ? fg::base : bg::base)
+                             : (is_fg ? fg::bright_base : bg::bright_base);
+  return SGR{base + index % 8};
+}
+
+// Sequence rendered at compile time for every ColorMode (empty for none);
+// streaming it picks the variant cached for the stream, see color_mode()
+struct Adaptive {
+  std::array<std::array<char, Ansi::max_size>, ncolor_modes> data{};
+  std::array<uint8_t, ncolor_modes> size{};
+
+  constexpr Adaptive(const Ansi &a) {
+    for (size_t mode = 1; mode < ncolor_modes; ++mode)
+      size[mode] = uint8_t(
+          downgrade(a, ColorMode(mode)).format(data[mode].data()));
+  }
+
+  constexpr std::string_view str(ColorMode mode) const {
+    return {data[size_t(mode)].data(), size[size_t(mode)]};
+  }
+};
+
+// Capabilities of the terminal behind fd, from isatty, NO_COLOR, TERM and
+// COLORTERM
+inline ColorMode detect_color_mode(int fd) {
+  const char *no_color = std::getenv("NO_COLOR");
+  if (no_color && *no_color) return ColorMode::none;
+  if (!::isatty(fd)) return ColorMode::none;
+  const char *term = std::getenv("TERM");
+  if (!term || std::strcmp(term, "dumb") == 0) return ColorMode::none;
+  const char *colorterm = std::getenv("COLORTERM");
+  if (colorterm && (std::strcmp(colorterm, "truecolor") == 0 ||
+                    std::strcmp(colorterm, "24bit") == 0))
+    return ColorMode::truecolor;
+  if (std::strstr(term, "256color")) return ColorMode::c256;
+  return ColorMode::basic;
+}
+
+inline int color_mode_slot() {
+  static const int slot = std::ios_base::xalloc();
+  return slot;
+}
+
+inline void set_color_mode(std::ios_base &os, ColorMode mode) {
+  os.iword(color_mode_slot()) = long(mode) + 1;
+}
+
+// Color mode of a stream, detected on first use and cached in the stream.
+// std::cout/cerr/clog are checked against their descriptors. String streams
+// default to truecolor, as their text is shown later by the caller; other
+// streams (files, custom buffers) to none. set_color_mode overrides both.
+inline ColorMode color_mode(std::ostream &os) {
+  long &word = os.iword(color_mode_slot());
+  if (!word) {
+    std::streambuf *const buf = os.rdbuf();
+    ColorMode mode = ColorMode::none;
+    if (&os == &std::cout || buf == std::cout.rdbuf())
+      mode = detect_color_mode(STDOUT_FILENO);
+    else if (&os == &std::cerr || &os == &std::clog ||
+             buf == std::cerr.rdbuf() || buf == std::clog.rdbuf())
+      mode = detect_color_mode(STDERR_FILENO);
+    else if (dynamic_cast<std::stringbuf *>(buf))
+      mode = ColorMode::truecolor;
+    word = long(mode) + 1;
+  }
+  return ColorMode(word - 1);
+}
+
+inline std::ostream &operator<<(std::ostream &os, const Adaptive &a) {
+  const std::string_view str = a.str(color_mode(os));
+  return os.write(str.data(), str.size());
+}
+
+// visible text
+
+// Returns the end of the escape sequence at p (*p == ESC): CSI up to its
+// final byte, OSC up to BEL or ST, otherwise ESC and one character
+inline const char *skip_escape(const char *p, const char *end) {
+  if (++p == end) return p;
+  if (*p == '[') {
+    for (++p; p < end; ++p)
+      if (*p >= 0x40 && *p <= 0x7e) return p + 1;
+    return end;
+  }
+  if (*p == ']') {
+    for (++p; p < end; ++p) {
+      if (*p == '\a') return p + 1;
+      if (*p == '\e' && p + 1 < end && p[1] == '\\') return p + 2;
+    }
+    return end;
+  }
+  return p + 1;
+}
+
+// Appends text without escape sequences to out; clean runs between ESC
+// bytes (found by memchr) are copied at once
+inline void strip(std::string &out, std::string_view text) {
+  const char *p = text.data();
+  const char *end = p + text.size();
+  while (p < end) {
+    const void *esc = std::memchr(p, '\e', end - p);
+    if (!esc) return void(out.append(p, end));
+    out.append(p, static_cast<const char *>(esc));
+    p = skip_escape(static_cast<const char *>(esc), end);
+  }
+}
+
+inline std::string strip(std::string_view text) {
+  std::string out;
+  out.reserve(text.size());
+  strip(out, text);
+  return out;
+}
+
+namespace unicode {
+
+struct Range {
+  char32_t first, last;
+};
+
+// combining marks, zero width spaces and joiners, variation selectors
+constexpr Range zero_width[] = {
+    {0x0300, 0x036F},   {0x0483, 0x0489},   {0x0591, 0x05BD},
+    {0x0610, 0x061A},   {0x064B, 0x065F},   {0x200B, 0x200F},
+    {0x202A, 0x202E},   {0x2060, 0x2064},   {0x20D0, 0x20FF},
+    {0xFE00, 0xFE0F},   {0xFE20, 0xFE2F},   {0xFEFF, 0xFEFF},
+    {0x1F3FB, 0x1F3FF}, {0xE0100, 0xE01EF},
+};
+
+// East Asian Wide and Fullwidth blocks, emoji presentation
+constexpr Range wide[] = {
+    {0x1100, 0x115F},   {0x231A, 0x231B},   {0x2329, 0x232A},
+    {0x23E9, 0x23EC},   {0x23F0, 0x23F0},   {0x23F3, 0x23F3},
+    {0x25FD, 0x25FE},   {0x2614, 0x2615},   {0x2648, 0x2653},
+    {0x267F, 0x267F},   {0x2693, 0x2693},   {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB},   {0x26BD, 0x26BE},   {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE},   {0x26D4, 0x26D4},   {0x26EA, 0x26EA},
+    {0x26F2, 0x26F3},   {0x26F5, 0x26F5},   {0x26FA, 0x26FA},
+    {0x26FD, 0x26FD},   {0x2705, 0x2705},   {0x270A, 0x270B},
+    {0x2728, 0x2728},   {0x274C, 0x274C},   {0x274E, 0x274E},
+    {0x2753, 0x2755},   {0x2757, 0x2757},   {0x2795, 0x2797},
+    {0x27B0, 0x27B0},   {0x27BF, 0x27BF},   {0x2B1B, 0x2B1C},
+    {0x2B50, 0x2B50},   {0x2B55, 0x2B55},   {0x2E80, 0x303E},
+    {0x3041, 0x33FF},   {0x3400, 0x4DBF},   {0x4E00, 0x9FFF},
+    {0xA000, 0xA4CF},   {0xA960, 0xA97F},   {0xAC00, 0xD7A3},
+    {0xF900, 0xFAFF},   {0xFE10, 0xFE19},   {0xFE30, 0xFE6F},
+    {0xFF00, 0xFF60},   {0xFFE0, 0xFFE6},   {0x16FE0, 0x16FE4},
+    {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004},
+    {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+    {0x1F200, 0x1F202}, {0x1F210, 0x1F23B}, {0x1F240, 0x1F248},
+    {0x1F250, 0x1F251}, {0x1F260, 0x1F265}, {0x1F300, 0x1F64F},
+    {0x1F680, 0x1F6FF}, {0x1F900, 0x1F9FF}, {0x1FA70, 0x1FAFF},
+    {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+template <size_t N>
+inline bool contains(const Range (&ranges)[N], char32_t cp) {
+  const Range *it = std::upper_bound(
+      ranges, ranges + N, cp,
+      [](char32_t cp, const Range &range) { return cp < range.first; });
+  return it != ranges && cp <= (it - 1)->last;
+}
+
+// Decodes the UTF-8 character at p and advances past it; a malformed byte
+// decodes as itself
+inline char32_t decode(const char *&p, const char *end) {
+  const unsigned char lead = *p++;
+  size_t extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+  if (lead < 0x80 || extra == 0 || size_t(end - p) < extra) return lead;
+  char32_t cp = lead & (0x3F >> extra);
+  for (size_t i = 0; i < extra; ++i) {
+    const unsigned char next = p[i];
+    if ((next & 0xC0) != 0x80) return lead;
+    cp = cp << 6 | (next & 0x3F);
+  }
+  p += extra;
+  return cp;
+}
+
+// Terminal columns taken by a code point: 0, 1 or 2
+inline int width(char32_t cp) {
+  if (cp < 0x20 || (cp >= 0x7F && cp < 0xA0)) return 0;
+  if (cp < 0x300) return 1;
+  if (contains(zero_width, cp)) return 0;
+  return contains(wide, cp) ? 2 : 1;
+}
+
+// Length of the run of printable ASCII at p, 16 bytes at a time with SSE2
+inline size_t ascii_run(const char *p, const char *end) {
+  const char *begin = p;
+#ifdef __SSE2__
+  const __m128i below = _mm_set1_epi8(0x1F);
+  const __m128i above = _mm_set1_epi8(0x7F);
+  for (; end - p >= 16; p += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    // bytes >= 0x80 are negative and fail the first comparison
+    const int mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above)));
+    if (mask != 0xFFFF) return p - begin + __builtin_ctz(~mask);
+  }
+#endif
+  while (p < end && *p >= 0x20 && *p < 0x7F) ++p;
+  return p - begin;
+}
+
+}  // namespace unicode
+
+// Terminal columns taken by text: escape sequences and control characters
+// take none, UTF-8 is decoded and East Asian wide characters take two
+inline size_t visible_width(std::string_view text) {
+  const char *p = text.data();
+  const char *end = p + text.size();
+  size_t width = 0;
+  while (p < end) {
+    const size_t run = unicode::ascii_run(p, end);
+    width += run;
+    p += run;
+    if (p == end) break;
+    if (*p == '\e')
+      p = skip_escape(p, end);
+    else
+      width += unicode::width(unicode::decode(p, end));
+  }
+  return width;
+}
+
 }  // namespace ansi
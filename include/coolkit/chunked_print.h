@@ -0,0 +1,202 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <utility>
+
+#include "pprint.h"
+
+// Incremental printing: the value is rendered through the regular Printer
+// dispatch in chunks of bounded size, each produced on demand, e.g.
+//
+//   ChunkedPrint chunks{state, opts};
+//   while (auto chunk = chunks.next()) send(*chunk);
+//
+// Printers run on a stack of their own (a ucontext) and are suspended when
+// the chunk buffer fills, so a server can interleave a dump with other
+// work, wait for socket backpressure between chunks, and cancel by
+// destroying the object. Stackless C++20 coroutines could not suspend
+// inside the nested Printer calls without rewriting every printer.
+//
+// Memory is one chunk plus the printer stack. The value must outlive the
+// ChunkedPrint and not change while it is printed.
+
+// Stack of the printer context with an inaccessible guard page below it,
+// so an overflow faults instead of corrupting the heap
+class GuardedStack {
+  void* base;
+  size_t length;
+  size_t guard;
+
+ public:
+  explicit GuardedStack(size_t size)
+      : guard(size_t(::sysconf(_SC_PAGESIZE))) {
+    length = (size + guard - 1) / guard * guard + guard;
+    base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) throw std::bad_alloc{};
+    ::mprotect(base, guard, PROT_NONE);
+  }
+  ~GuardedStack() { ::munmap(base, length); }
+  GuardedStack(const GuardedStack&) = delete;
+  GuardedStack& operator=(const GuardedStack&) = delete;
+
+  void* data() const { return static_cast<char*>(base) + guard; }
+  size_t size() const { return length - guard; }
+};
+
+// Output buffer of one chunk; yields to the consumer when full
+class chunkbuf : public std::streambuf {
+  std::unique_ptr<char[]> buffer;  // not value-initialized
+  size_t capacity;
+  ucontext_t* printer = nullptr;
+  ucontext_t* consumer = nullptr;
+  bool cancelled = false;
+
+  // hands the full chunk to the consumer; false once cancelled
+  bool yield() {
+    if (cancelled) return false;
+    swapcontext(printer, consumer);
+    setp(buffer.get(), buffer.get() + capacity);
+    return !cancelled;
+  }
+
+ protected:
+  virtual int overflow(int ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+      return traits_type::not_eof(ch);
+    if (pptr() == epptr() && !yield()) return traits_type::eof();
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+  }
+
+  virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+    std::streamsize done = 0;
+    while (done < n) {
+      if (pptr() == epptr() && !yield()) break;
+      const size_t size = std::min(size_t(n - done), size_t(epptr() - pptr()));
+      std::memcpy(pptr(), s + done, size);
+      pbump(int(size));
+      done += std::streamsize(size);
+    }
+    return done;
+  }
+
+ public:
+  explicit chunkbuf(size_t capacity)
+      : buffer(new char[capacity]), capacity(capacity) {
+    setp(buffer.get(), buffer.get() + capacity);
+  }
+
+  void attach(ucontext_t* printer, ucontext_t* consumer) {
+    this->printer = printer;
+    this->consumer = consumer;
+  }
+  void cancel() { cancelled = true; }
+
+  std::string_view view() const { return {pbase(), size_t(pptr() - pbase())}; }
+  void clear() { setp(buffer.get(), buffer.get() + capacity); }
+};
+
+class ChunkedPrint {
+  using Render = void (*)(PrintContext&, const void*);
+
+  const void* val;
+  Render render;
+  PrintOptions opts;
+  chunkbuf buf;
+  std::ostream os{&buf};
+  GuardedStack stack;
+  ucontext_t printer{};
+  ucontext_t consumer{};
+  bool started = false;
+  bool finished = false;
+  bool pending = false;  // a chunk was handed out and not cleared yet
+  std::exception_ptr error;
+
+  template <typename T>
+  static void render_value(PrintContext& ctx, const void* val) {
+    ::print_impl(ctx, *static_cast<const T*>(val));
+  }
+
+  void run() {
+    try {
+      PrintContext ctx{os, opts};
+      render(ctx, val);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    finished = true;
+  }
+
+  // makecontext passes int arguments only
+  static void entry(unsigned hi, unsigned lo) {
+    const uintptr_t ptr = uintptr_t(hi) << 32 | uintptr_t(lo);
+    reinterpret_cast<ChunkedPrint*>(ptr)->run();
+  }
+
+ public:
+  // chunk_size bounds every chunk. stack_size must hold the deepest nesting
+  // of printers for the value: a tree of structs holding vectors of
+  // children takes about 4 KiB per level, so the default holds some 60
+  // levels. Deeper values crash on the guard page below the stack.
+  template <typename T>
+  explicit ChunkedPrint(const T& val, const PrintOptions& opts = {},
+                        size_t chunk_size = 64 << 10,
+                        size_t stack_size = 256 << 10)
+      : val(&val),
+        render(&render_value<T>),
+        opts(opts),
+        buf(chunk_size),
+        stack(stack_size) {
+    getcontext(&printer);
+    printer.uc_stack.ss_sp = stack.data();
+    printer.uc_stack.ss_size = stack.size();
+    printer.uc_link = &consumer;  // back to next() when printing ends
+    const uintptr_t self = reinterpret_cast<uintptr_t>(this);
+    makecontext(&printer, reinterpret_cast<void (*)()>(&entry), 2,
+                unsigned(uint64_t(self) >> 32), unsigned(self));
+    buf.attach(&printer, &consumer);
+  }
+
+  // Cancels a print in progress: the printer runs to its end with every
+  // write failing, so no more output is rendered
+  ~ChunkedPrint() {
+    if (started && !finished) {
+      buf.cancel();
+      swapcontext(&consumer, &printer);
+    }
+  }
+  ChunkedPrint(const ChunkedPrint&) = delete;
+  ChunkedPrint& operator=(const ChunkedPrint&) = delete;
+
+  // The next chunk, valid until the following call; nullopt at the end.
+  // Rethrows std::bad_alloc from a printer.
+  std::optional<std::string_view> next() {
+    if (pending) buf.clear();
+    pending = false;
+    if (finished) return std::nullopt;
+    started = true;
+    swapcontext(&consumer, &printer);
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+    const std::string_view chunk = buf.view();
+    if (chunk.empty()) return std::nullopt;
+    pending = true;
+    return chunk;
+  }
+
+  bool done() const { return finished && !pending; }
+};
@@ -1,34 +1,82 @@
 #pragma once
 
+#include <array>
+#include <cstdlib>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
 #include "macro.h"
 
 template <typename EnumT>
 struct Enum;
 
+// Default fallback of Enum<T>::visit: values that are not enumerators abort
+struct EnumVisitAbort {};
+
+// Result type and fallback of Enum<T>::visit, which switches over the
+// enumerators so the compiler picks a jump table or a compare tree and can
+// inline every handler
+template <typename T>
+struct EnumDispatch {
+  template <typename F>
+  using Result = decltype(std::declval<F&>()(
+      std::integral_constant<T, Enum<T>::values[0]>{}));
+
+  // values that are not enumerators go to fallback(value)
+  template <typename F, typename Fallback>
+  static constexpr Result<F> unknown(Fallback& fallback, T value) {
+    if constexpr (std::is_same_v<Fallback, EnumVisitAbort>) {
+      (void)fallback, (void)value;
+      std::abort();
+    } else {
+      return fallback(value);
+    }
+  }
+};
+
 #define ENUM_STR_CASE(Type, field) \
   case Type::field:                \
     return #field;
+#define ENUM_VISIT_CASE(Type, field) \
+  case Type::field:                  \
+    return f(std::integral_constant<Type, Type::field>{});
 
-#define ENUM(Type, ...)                                                 \
-  template <>                                                           \
-  struct Enum<Type> {                                                   \
-    inline static Type values[]{                                        \
-        PP_FOREACH_LIST(PP_BIND(PP_BINARY_OP, ::, Type), __VA_ARGS__)}; \
-    static constexpr size_t size = std::size(values);                   \
-                                                                        \
-    template <typename F>                                               \
-    static void foreach (F&& f) {                                       \
-      for (auto value : values) f(value);                               \
-    }                                                                   \
-                                                                        \
-    static constexpr std::string_view string(Type value) {              \
-      switch (value) {                                                  \
-        PP_FOREACH(PP_BIND(ENUM_STR_CASE, Type), __VA_ARGS__);          \
-        default:                                                        \
-          break;                                                        \
-      }                                                                 \
-      return #Type "::(unknown)";                                       \
-    }                                                                   \
+// values is a constexpr std::array in declaration order. visit(value, f)
+// calls f(std::integral_constant<Type, V>{}) for the enumerator V equal to
+// value, as a switch written by hand would; f returns the same type for
+// every V. Other values go to fallback(value), which aborts by default.
+#define ENUM(Type, ...)                                                     \
+  template <>                                                               \
+  struct Enum<Type> {                                                       \
+    static constexpr std::array values{                                     \
+        PP_FOREACH_LIST(PP_BIND(PP_BINARY_OP, ::, Type), __VA_ARGS__)};     \
+    static constexpr size_t size = values.size();                           \
+                                                                            \
+    template <typename F>                                                   \
+    static constexpr void foreach (F&& f) {                                 \
+      for (auto value : values) f(value);                                   \
+    }                                                                       \
+                                                                            \
+    template <typename F, typename Fallback = EnumVisitAbort>               \
+    static constexpr decltype(auto) visit(Type value, F&& f,                \
+                                          Fallback&& fallback = {}) {       \
+      switch (value) {                                                      \
+        PP_FOREACH(PP_BIND(ENUM_VISIT_CASE, Type), __VA_ARGS__);            \
+        default:                                                            \
+          break;                                                            \
+      }                                                                     \
+      return EnumDispatch<Type>::template unknown<F>(fallback, value);      \
+    }                                                                       \
+                                                                            \
+    static constexpr std::string_view string(Type value) {                  \
+      switch (value) {                                                      \
+        PP_FOREACH(PP_BIND(ENUM_STR_CASE, Type), __VA_ARGS__);              \
+        default:                                                            \
+          break;                                                            \
+      }                                                                     \
+      return #Type "::(unknown)";                                           \
+    }                                                                       \
   };
 
 #define DEFINE_ENUM(Type, ...) \
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "indentos.h"
+#include "memstat.h"
+#include "pprint.h"
+
+// Type-erased printing, an opt-in alternative to print() for binaries where
+// the Printer instantiations of every printed type cost too much code.
+//
+// Every type gets one small table, an ErasedPrinter, and containers reach
+// their elements through it: the loops, punctuation, indentation and
+// colors live in shared non-template functions, and numbers and strings
+// are widened to a few common types. A new range type costs its iteration
+// function, not another copy of the range printer.
+//
+// The output is the same as print() without a width. Width layouts,
+// summaries, collapsed runs and pointer following are not supported and
+// ignored. Structs, enums and other types print through their regular
+// Printer; Printer specializations of ranges, pairs, tuples and optionals
+// are bypassed.
+
+struct ErasedPrinter {
+  void (*print)(const PrintContext& ctx, const void* val);
+  size_t (*memstat)(const void* val);  // nullptr if not memstattable
+  bool is_small;
+};
+
+template <typename T>
+void erased_print_thunk(const PrintContext& ctx, const void* val);
+
+template <typename T>
+size_t erased_memstat(const void* val) {
+  return ::memstat(*static_cast<const T*>(val)).nbytes;
+}
+
+template <typename T>
+inline constexpr ErasedPrinter erased_printer{
+    &erased_print_thunk<T>,
+    is_memstattable_v<T> ? &erased_memstat<T> : nullptr, is_small_type_v<T>};
+
+// shared core
+
+// print_impl() through the table
+inline void erased_print(const PrintContext& ctx, const void* val,
+                         const ErasedPrinter& printer) {
+  printer.print(ctx, val);
+  if (ctx.memstat && printer.memstat) {
+    if (ctx.colors) ctx.os << Theme::color_memstat;
+    ctx.os << "<" << Memsize{printer.memstat(val)} << ">";
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  }
+}
+
+template <typename T>
+void erased_print(const PrintContext& ctx, const T& val) {
+  erased_print(ctx, &val, erased_printer<T>);
+}
+
+inline void erased_print_number(const PrintContext& ctx, long long val) {
+  if (ctx.colors) ctx.os << Theme::color_number;
+  ctx.os << val;
+  if (ctx.colors) ctx.os << Theme::color_reset;
+}
+
+inline void erased_print_number(const PrintContext& ctx,
+                                unsigned long long val) {
+  if (ctx.colors) ctx.os << Theme::color_number;
+  ctx.os << val;
+  if (ctx.colors) ctx.os << Theme::color_reset;
+}
+
+inline void erased_print_number(const PrintContext& ctx, double val) {
+  if (ctx.colors) ctx.os << Theme::color_number;
+  ctx.os << val;
+  if (ctx.colors) ctx.os << Theme::color_reset;
+}
+
+inline void erased_print_number(const PrintContext& ctx, long double val) {
+  if (ctx.colors) ctx.os << Theme::color_number;
+  ctx.os << val;
+  if (ctx.colors) ctx.os << Theme::color_reset;
+}
+
+inline void erased_print_string(const PrintContext& ctx,
+                                std::string_view str) {
+  if (ctx.colors) ctx.os << Theme::color_string;
+  if (ctx.quotes)
+    write_quoted(ctx.os, str);
+  else
+    ctx.os << str;
+  if (ctx.colors) ctx.os << Theme::color_reset;
+}
+
+inline void erased_print_nullopt(const PrintContext& ctx) {
+  if (ctx.colors) ctx.os << Theme::color_constant;
+  ctx.os << "<nullopt>";
+  if (ctx.colors) ctx.os << Theme::color_reset;
+}
+
+inline void erased_print_blob(PrintContext ctx, const unsigned char* bytes,
+                              size_t size) {
+  BlobPrinter printer{ctx, bytes, size};
+  if (!ctx.multiline || size <= 16)
+    printer.print_inline();
+  else
+    printer.print_rows();
+}
+
+// Receives the elements of a range in order; false stops the iteration
+class ErasedVisitor {
+ protected:
+  ~ErasedVisitor() = default;
+
+ public:
+  virtual bool visit(const void* key, const void* value) = 0;
+};
+
+struct ErasedRange {
+  const ErasedPrinter* key;    // the elements, or the keys of a map
+  const ErasedPrinter* value;  // the mapped values of a map, else nullptr
+  PunctuatorSet punct;
+  bool is_small;
+  void (*each)(const void* range, ErasedVisitor& visitor);
+};
+
+inline void erased_print_range(PrintContext ctx, const void* range,
+                               const ErasedRange& erased) {
+  class Elements : public ErasedVisitor {
+    const PrintContext& ctx;
+    const ErasedRange& erased;
+    const PunctuatorSet& punct;
+    bool first = true;
+
+   public:
+    Elements(const PrintContext& ctx, const ErasedRange& erased,
+             const PunctuatorSet& punct)
+        : ctx(ctx), erased(erased), punct(punct) {}
+
+    bool visit(const void* key, const void* value) override {
+      if (!first) ctx.os << punct.sep;
+      ctx.os << punct.split;
+      erased_print(ctx, key, *erased.key);
+      if (value) {
+        ctx.os << ": ";
+        erased_print(ctx, value, *erased.value);
+      }
+      first = false;
+      // a failed stream ends the range early
+      return ctx.os.good();
+    }
+  };
+
+  PunctuatorSet punct = erased.punct;
+  apply_layout(ctx, punct, !ctx.multiline || erased.is_small);
+  ctx.os << punct.start;
+  {
+    const indentos indent{ctx.os, false};
+    Elements elements{ctx, erased, punct};
+    erased.each(range, elements);
+  }
+  ctx.os << punct.split << punct.end;
+}
+
+struct ErasedField {
+  const void* val;
+  const ErasedPrinter* printer;
+};
+
+// (a, b, c) of pairs and tuples
+inline void erased_print_fields(PrintContext ctx, const ErasedField* fields,
+                                size_t size, bool is_small) {
+  PunctuatorSet punct = punct::statlist;
+  apply_layout(ctx, punct, !ctx.multiline || is_small);
+  ctx.os << punct.start;
+  {
+    const indentos indent{ctx.os, false};
+    for (size_t i = 0; i < size; ++i) {
+      if (i) ctx.os << punct.sep;
+      ctx.os << punct.split;
+      erased_print(ctx, fields[i].val, *fields[i].printer);
+    }
+  }
+  ctx.os << punct.split << punct.end;
+}
+
+// per-type parts
+
+template <typename T>
+void erased_each(const void* ptr, ErasedVisitor& visitor) {
+  const T& range = *static_cast<const T*>(ptr);
+  for (const auto& element : range) {
+    bool more;
+    if constexpr (is_map_like_v<T>)
+      more = visitor.visit(&element.first, &element.second);
+    else
+      more = visitor.visit(&element, nullptr);
+    if (!more) return;
+  }
+}
+
+template <typename T>
+constexpr ErasedRange make_erased_range() {
+  using value_type = typename std::iterator_traits<decltype(std::begin(
+      std::declval<const T&>()))>::value_type;
+  if constexpr (is_map_like_v<T>) {
+    return {&erased_printer<typename T::key_type>,
+            &erased_printer<typename T::mapped_type>, punct::keylist, false,
+            &erased_each<T>};
+  } else {
+    return {&erased_printer<value_type>, nullptr,
+            has_keys_v<T> ? punct::keylist : punct::dynlist,
+            is_small_type_v<value_type>, &erased_each<T>};
+  }
+}
+
+template <typename T>
+inline constexpr ErasedRange erased_range = make_erased_range<T>();
+
+template <typename T>
+void erased_print_value(const PrintContext& ctx, const T& val) {
+  using U = std::remove_cv_t<T>;
+  constexpr bool is_char = std::is_same_v<U, char> ||
+                           std::is_same_v<U, wchar_t> ||
+                           std::is_same_v<U, char16_t> ||
+                           std::is_same_v<U, char32_t>;
+  if constexpr (has_context_print_method_v<T> || has_print_method_v<T>) {
+    Printer<T>::print(ctx, val);
+  } else if constexpr (is_string_like_v<T>) {
+    erased_print_string(ctx, val);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    using Wide = std::conditional_t<std::is_same_v<U, long double>,
+                                    long double, double>;
+    erased_print_number(ctx, Wide(val));
+  } else if constexpr (std::is_integral_v<T> && !is_char) {
+    using Wide = std::conditional_t<std::is_signed_v<T>, long long,
+                                    unsigned long long>;
+    erased_print_number(ctx, Wide(val));
+  } else if constexpr (is_byte_range_v<T>) {
+    erased_print_blob(
+        ctx, reinterpret_cast<const unsigned char*>(std::data(val)),
+        std::size(val));
+  } else if constexpr (is_range_v<T>) {
+    erased_print_range(ctx, &val, erased_range<T>);
+  } else {
+    Printer<T>::print(ctx, val);
+  }
+}
+
+template <typename A, typename B>
+void erased_print_value(const PrintContext& ctx, const std::pair<A, B>& pair) {
+  const ErasedField fields[] = {{&pair.first, &erased_printer<A>},
+                                {&pair.second, &erased_printer<B>}};
+  erased_print_fields(ctx, fields, 2,
+                      is_small_type_v<A> && is_small_type_v<B>);
+}
+
+template <typename... Types>
+void erased_print_value(const PrintContext& ctx,
+                        const std::tuple<Types...>& tuple) {
+  std::apply(
+      [&](const auto&... args) {
+        const ErasedField fields[] = {
+            {&args, &erased_printer<std::decay_t<decltype(args)>>}...};
+        erased_print_fields(ctx, fields, sizeof...(Types),
+                            (is_small_type<Types>::value && ...));
+      },
+      tuple);
+}
+
+inline void erased_print_value(const PrintContext& ctx, const std::tuple<>&) {
+  erased_print_fields(ctx, nullptr, 0, true);
+}
+
+template <typename T>
+void erased_print_value(const PrintContext& ctx, const std::optional<T>& opt) {
+  if (opt)
+    erased_print(ctx, *opt);
+  else
+    erased_print_nullopt(ctx);
+}
+
+template <typename T>
+void erased_print_thunk(const PrintContext& ctx, const void* val) {
+  erased_print_value(ctx, *static_cast<const T*>(val));
+}
+
+// entry points, same as print(), stringify(), printout() and printerr()
+
+inline PrintContext erased_context(std::ostream& os,
+                                   const PrintOptions& opts) {
+  PrintContext ctx{os, opts};
+  ctx.width = 0;
+  ctx.summarize = 0;
+  ctx.collapse = 0;
+  ctx.follow_pointers = false;
+  return ctx;
+}
+
+template <typename T>
+void print_erased(std::ostream& os, const T& val,
+                  const PrintOptions& opts = {}) {
+  if (!is_sink_enabled(os)) return;
+  erased_print(erased_context(os, opts), val);
+}
+
+template <typename T>
+std::string stringify_erased(const T& val, const PrintOptions& opts = {}) {
+  std::stringstream ss;
+  print_erased(ss, val, opts);
+  return ss.str();
+}
+
+template <typename T>
+void printout_erased(const T& val) {
+  PrintOptions opts;
+  opts.quotes = true;
+  opts.colors = false;
+  erased_print(erased_context(std::cout, opts), val);
+  std::cout << "\n";
+}
+
+template <typename T>
+void printerr_erased(const T& val) {
+  erased_print(erased_context(std::cerr, {}), val);
+  std::cerr << "\n";
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+
+#include "pprint.h"
+
+// Output buffer writing straight to a file descriptor, for very large dumps.
+// Small fragments are staged in one large buffer; payloads of at least
+// `direct_size` bytes are not copied but submitted from the caller's memory
+// together with the staged bytes in a single writev(2).
+class fdbuf : public std::streambuf {
+  int fd;
+  size_t direct_size;
+  std::unique_ptr<char[]> buffer;  // not value-initialized
+  size_t buffer_size;
+  size_t nsyscalls = 0;
+
+  bool write_all(iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+      const ssize_t n = ::writev(fd, iov, iovcnt);
+      nsyscalls++;
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      size_t left = static_cast<size_t>(n);
+      while (iovcnt > 0 && left >= iov->iov_len) {
+        left -= iov->iov_len;
+        iov++;
+        iovcnt--;
+      }
+      if (iovcnt > 0) {
+        iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+        iov->iov_len -= left;
+      }
+    }
+    return true;
+  }
+
+  // Submits the staged bytes followed by [data, data + size)
+  bool submit(const char* data, size_t size) {
+    iovec iov[2] = {{pbase(), static_cast<size_t>(pptr() - pbase())},
+                    {const_cast<char*>(data), size}};
+    const bool ok = write_all(iov, 2);
+    setp(buffer.get(), buffer.get() + buffer_size);
+    return ok;
+  }
+
+ protected:
+  virtual int overflow(int ch) {
+    if (!submit(nullptr, 0)) return traits_type::eof();
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+      return traits_type::not_eof(ch);
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+  }
+
+  virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+    const size_t size = static_cast<size_t>(n);
+    if (size >= direct_size) return submit(s, size) ? n : 0;
+    if (size > static_cast<size_t>(epptr() - pptr()) && !submit(nullptr, 0))
+      return 0;
+    std::memcpy(pptr(), s, size);
+    pbump(static_cast<int>(size));
+    return n;
+  }
+
+  virtual int sync() { return submit(nullptr, 0) ? 0 : -1; }
+
+ public:
+  explicit fdbuf(int fd, size_t buffer_size = 1 << 20,
+                 size_t direct_size = 4096)
+      : fd(fd),
+        direct_size(std::min(direct_size, buffer_size)),
+        buffer(new char[buffer_size]),
+        buffer_size(buffer_size) {
+    setp(buffer.get(), buffer.get() + buffer_size);
+  }
+  virtual ~fdbuf() { sync(); }
+  fdbuf(const fdbuf&) = delete;
+  fdbuf& operator=(const fdbuf&) = delete;
+
+  // number of writev calls so far
+  size_t syscalls() const { return nsyscalls; }
+};
+
+// Prints val into fd through an fdbuf; returns false on write errors
+template <typename T>
+bool print_fd(int fd, const T& val, const PrintOptions& opts = {}) {
+  fdbuf buf{fd};
+  std::ostream os{&buf};
+  ansi::set_color_mode(os, ansi::detect_color_mode(fd));
+  PrintContext ctx{os, opts};
+  print_impl(ctx, val);
+  os.flush();
+  return !os.bad();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstring>
 #include <iostream>
 #include <string_view>
 
@@ -16,6 +17,23 @@ class indentos : public std::streambuf {
     return rdbuf->sputc(ch);
   }
 
+  // same as overflow() per char, but forwards whole lines at once
+  virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+    std::streamsize done = 0;
+    while (done < n) {
+      if (newline && s[done] != '\n')
+        rdbuf->sputn(indent.data(), indent.size());
+      const void* nl = std::memchr(s + done, '\n', n - done);
+      const std::streamsize len =
+          nl ? static_cast<const char*>(nl) - (s + done) + 1 : n - done;
+      const std::streamsize written = rdbuf->sputn(s + done, len);
+      done += written;
+      if (written != len) break;
+      newline = nl != nullptr;
+    }
+    return done;
+  }
+
  public:
   explicit indentos(std::ostream& os, bool newline = true)
       : rdbuf(os.rdbuf()), newline(newline), os(os) {
@@ -72,9 +72,242 @@
   _PP_FOREACH_REPEAT PP_PACK(PP_NOT(PP_IS_EMPTY(__VA_ARGS__)), sep)( \
       macro, sep, __VA_ARGS__)
 
-#define PP_FOREACH_SEP(macro, sep, ...)                             \
-  PP_IF(PP_NOT(PP_IS_EMPTY(__VA_ARGS__)), _PP_EXPAND256, PP_IGNORE) \
-  (_PP_FOREACH(PP_PACK(macro), PP_PACK(sep), __VA_ARGS__))
+// arity-dispatched foreach: counts the args first and picks an expansion of
+// matching depth, so short lists don't pay for 256 rescans; longer lists
+// fall back to the recursive _PP_FOREACH above
+#define PP_FOREACH_MAX_ARITY 64
+
+#define _PP_ARG_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, \
+  _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29,   \
+  _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44,   \
+  _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59,   \
+  _60, _61, _62, _63, _64, N, ...) N
+#define PP_NARGS(...) _PP_ARG_N(__VA_ARGS__, 64, 63, 62, 61, 60, 59, 58, 57,  \
+  56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, \
+  37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, \
+  18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+
+// 1 if the list has more than PP_FOREACH_MAX_ARITY args
+#define _PP_ARITY_OVERFLOW(...) PP_NOT(PP_IS_EMPTY(_PP_ARG_N(__VA_ARGS__, , , \
+  , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , , \
+  , , , , , , , , , , , , , , , , , , , , , , , , )))
+
+#define _PP_FOREACH_STEP(macro, x) PP_APPLY(PP_UNPACK(macro), x)
+#define _PP_FOREACH_1(macro, sep, x) _PP_FOREACH_STEP(macro, x)
+// a trailing comma leaves an empty last arg, which the recursive
+// expansion drops; so does the last step here
+#define _PP_FOREACH_LAST(cond, sep) \
+  PP_IF(cond, PP_UNPACK, PP_IGNORE) \
+  (sep) PP_IF(cond, _PP_FOREACH_1, PP_IGNORE)
+#define _PP_FOREACH_2(macro, sep, x, ...)                         \
+  _PP_FOREACH_STEP(macro, x)                                      \
+  _PP_FOREACH_LAST(PP_NOT(PP_IS_EMPTY(__VA_ARGS__)), sep)(macro, sep, \
+                                                          __VA_ARGS__)
+#define _PP_FOREACH_3(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_2(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_4(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_3(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_5(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_4(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_6(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_5(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_7(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_6(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_8(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_7(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_9(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)              \
+  PP_UNPACK(sep) _PP_FOREACH_8(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_10(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_9(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_11(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_10(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_12(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_11(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_13(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_12(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_14(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_13(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_15(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_14(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_16(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_15(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_17(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_16(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_18(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_17(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_19(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_18(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_20(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_19(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_21(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_20(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_22(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_21(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_23(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_22(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_24(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_23(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_25(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_24(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_26(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_25(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_27(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_26(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_28(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_27(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_29(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_28(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_30(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_29(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_31(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_30(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_32(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_31(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_33(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_32(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_34(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_33(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_35(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_34(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_36(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_35(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_37(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_36(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_38(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_37(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_39(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_38(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_40(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_39(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_41(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_40(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_42(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_41(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_43(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_42(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_44(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_43(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_45(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_44(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_46(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_45(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_47(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_46(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_48(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_47(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_49(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_48(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_50(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_49(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_51(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_50(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_52(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_51(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_53(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_52(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_54(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_53(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_55(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_54(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_56(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_55(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_57(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_56(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_58(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_57(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_59(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_58(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_60(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_59(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_61(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_60(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_62(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_61(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_63(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_62(macro, sep, __VA_ARGS__)
+#define _PP_FOREACH_64(macro, sep, x, ...) \
+  _PP_FOREACH_STEP(macro, x)               \
+  PP_UNPACK(sep) _PP_FOREACH_63(macro, sep, __VA_ARGS__)
+
+#define _PP_FOREACH_RECURSIVE(macro, sep, ...) \
+  _PP_EXPAND256(_PP_FOREACH(macro, sep, __VA_ARGS__))
+#define _PP_FOREACH_ARITY(macro, sep, ...) \
+  PP_CAT(_PP_FOREACH_, PP_NARGS(__VA_ARGS__))(macro, sep, __VA_ARGS__)
+
+#ifdef PP_FOREACH_NO_ARITY_DISPATCH
+#define _PP_FOREACH_DISPATCH(macro, sep, ...) \
+  _PP_FOREACH_RECURSIVE(macro, sep, __VA_ARGS__)
+#else
+#define _PP_FOREACH_DISPATCH(macro, sep, ...)                          \
+  PP_IF(_PP_ARITY_OVERFLOW(__VA_ARGS__), _PP_FOREACH_RECURSIVE,        \
+        _PP_FOREACH_ARITY)                                             \
+  (macro, sep, __VA_ARGS__)
+#endif
+
+#define PP_FOREACH_SEP(macro, sep, ...)                                     \
+  PP_IF(PP_NOT(PP_IS_EMPTY(__VA_ARGS__)), _PP_FOREACH_DISPATCH, PP_IGNORE) \
+  (PP_PACK(macro), PP_PACK(sep), __VA_ARGS__)
 
 #define PP_FOREACH(macro, ...) \
   PP_FOREACH_SEP(PP_PASS(macro), PP_EMPTY, __VA_ARGS__)
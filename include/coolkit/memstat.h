@@ -1,19 +1,25 @@
 #pragma once
 
+#include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <forward_list>
 #include <iomanip>
 #include <list>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <queue>
 #include <set>
 #include <stack>
 #include <string>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
+#include <variant>
 #include <vector>
 
 // Helper to detect if type has memstat method
@@ -38,19 +44,33 @@ inline std::ostream& operator<<(std::ostream& os, Memsize memsize) {
 
   size_t bits = 0;
   for (size_t n = value; n > 0; n >>= 1) bits++;
-  unit = (bits - 1) / 10;
+  if (bits > 0) unit = (bits - 1) / 10;
 
   if (unit > 0) {
     size_t divisor = size_t(1) << (unit * 10);
     size_t whole = value / divisor;
     size_t fraction = ((value % divisor) * 100) / divisor;
-    os << whole << "." << std::setw(2) << std::setfill('0') << fraction << units[unit];
+    const char fill = os.fill('0');
+    os << whole << "." << std::setw(2) << fraction << units[unit];
+    os.fill(fill);
   } else {
     os << value << units[unit];
   }
   return os;
 }
 
+// Reserved-but-unused memory owned directly by a container (not counting
+// its elements), see Memstat<T>::slack and memstat_slack.h
+struct Memslack {
+  const char* kind = "";
+  size_t reserved = 0;     // bytes of the own buffer or bucket array
+  size_t unused = 0;       // part of reserved that holds no elements
+  size_t recoverable = 0;  // bytes released by calling fix
+  const char* fix = "";
+  size_t empty_buckets = 0;  // hash containers only
+  float load_factor = 0;
+};
+
 template <typename T, typename = void>
 struct Memstat {
   static size_t memstat(const T& val) {
@@ -62,9 +82,116 @@ struct Memstat {
   }
 };
 
+// Open-addressing set of object addresses, for marking heap objects that
+// were already counted
+class PointerSet {
+  std::vector<const void*> slots;
+  size_t count = 0;
+
+  static size_t hash(const void* ptr) {
+    uint64_t x = reinterpret_cast<uintptr_t>(ptr);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+  }
+
+  void grow() {
+    std::vector<const void*> old(slots.empty() ? 64 : slots.size() * 2);
+    old.swap(slots);
+    count = 0;
+    for (const void* ptr : old)
+      if (ptr) insert(ptr);
+  }
+
+ public:
+  // Returns false if ptr is already in the set
+  bool insert(const void* ptr) {
+    if ((count + 1) * 2 > slots.size()) grow();
+    const size_t mask = slots.size() - 1;
+    for (size_t i = hash(ptr) & mask;; i = (i + 1) & mask) {
+      if (slots[i] == ptr) return false;
+      if (!slots[i]) {
+        slots[i] = ptr;
+        count++;
+        return true;
+      }
+    }
+  }
+
+  bool contains(const void* ptr) const {
+    if (slots.empty()) return false;
+    const size_t mask = slots.size() - 1;
+    for (size_t i = hash(ptr) & mask; slots[i]; i = (i + 1) & mask)
+      if (slots[i] == ptr) return true;
+    return false;
+  }
+
+  void merge(const PointerSet& other) {
+    for (const void* ptr : other.slots)
+      if (ptr) insert(ptr);
+  }
+
+  size_t size() const { return count; }
+};
+
+// Traversal state shared by all memstat calls nested in the outermost one
+// on this thread, so an object reachable through several shared owners is
+// counted once and pointer cycles terminate
+class MemstatContext {
+  PointerSet visited;
+  PointerSet* counted = nullptr;  // by earlier measurements, skipped
+  inline static thread_local MemstatContext* current = nullptr;
+  friend class MemstatScope;
+
+ public:
+  MemstatContext() = default;
+  // Measures one part of a larger traversal: objects in counted are not
+  // counted again, commit() adds the ones reached by this part
+  explicit MemstatContext(PointerSet& counted) : counted(&counted) {}
+  MemstatContext(const MemstatContext&) = delete;
+  MemstatContext& operator=(const MemstatContext&) = delete;
+
+  void commit() {
+    if (counted) counted->merge(visited);
+  }
+
+  // True the first time ptr is seen within the active MemstatScope
+  static bool first_visit(const void* ptr) {
+    if (!current) return true;
+    if (current->counted && current->counted->contains(ptr)) return false;
+    return current->visited.insert(ptr);
+  }
+};
+
+// Installs a MemstatContext unless one is already active
+class MemstatScope {
+  MemstatContext ctx;  // an empty set does not allocate
+  MemstatContext* saved = nullptr;
+  bool owner = false;
+
+ public:
+  MemstatScope() {
+    if (MemstatContext::current) return;
+    owner = true;
+    MemstatContext::current = &ctx;
+  }
+  // Installs ctx until the scope ends, for measuring with a given context
+  explicit MemstatScope(MemstatContext& ctx)
+      : saved(MemstatContext::current), owner(true) {
+    MemstatContext::current = &ctx;
+  }
+  ~MemstatScope() {
+    if (owner) MemstatContext::current = saved;
+  }
+  MemstatScope(const MemstatScope&) = delete;
+  MemstatScope& operator=(const MemstatScope&) = delete;
+};
+
 // Main function
 template <typename T>
 Memsize memstat(const T& val) {
+  const MemstatScope scope;
   return {Memstat<T>::memstat(val)};
 }
 
@@ -77,6 +204,19 @@ struct Memstat<std::basic_string<C, T, A>> {
     if (str.capacity() > sso_length) size += str.capacity() * sizeof(C);
     return size;
   }
+
+  static Memslack slack(const std::basic_string<C, T, A>& str) {
+    static const size_t sso_length = std::basic_string<C, T, A>{}.capacity();
+    Memslack res;
+    res.kind = "string";
+    if (str.capacity() <= sso_length) return res;
+    res.reserved = str.capacity() * sizeof(C);
+    res.unused = (str.capacity() - str.size()) * sizeof(C);
+    // short strings move back into the inline buffer
+    res.recoverable = str.size() <= sso_length ? res.reserved : res.unused;
+    res.fix = "shrink_to_fit";
+    return res;
+  }
 };
 
 // std::vector
@@ -88,6 +228,16 @@ struct Memstat<std::vector<T, A>> {
     for (const auto& elem : vec) size += Memstat<T>::memstat(elem) - sizeof(T);
     return size;
   }
+
+  static Memslack slack(const std::vector<T, A>& vec) {
+    Memslack res;
+    res.kind = "vector";
+    res.reserved = vec.capacity() * sizeof(T);
+    res.unused = (vec.capacity() - vec.size()) * sizeof(T);
+    res.recoverable = res.unused;
+    res.fix = "shrink_to_fit";
+    return res;
+  }
 };
 
 // std::deque
@@ -141,6 +291,25 @@ struct Memstat<std::set<T, C, A>> {
   }
 };
 
+// Bucket array slack of unordered containers: rehash(0) shrinks the array
+// to the smallest size that keeps load_factor() <= max_load_factor()
+template <typename U>
+Memslack memslack_buckets(const U& set, const char* kind) {
+  Memslack res;
+  res.kind = kind;
+  res.reserved = set.bucket_count() * sizeof(void*);
+  for (size_t i = 0; i < set.bucket_count(); ++i)
+    if (set.bucket_size(i) == 0) res.empty_buckets++;
+  res.unused = res.empty_buckets * sizeof(void*);
+  res.load_factor = set.load_factor();
+  const size_t needed =
+      static_cast<size_t>(std::ceil(set.size() / set.max_load_factor()));
+  if (set.bucket_count() > needed)
+    res.recoverable = (set.bucket_count() - needed) * sizeof(void*);
+  res.fix = "rehash(0)";
+  return res;
+}
+
 // std::unordered_set
 template <typename T, typename H, typename E, typename A>
 struct Memstat<std::unordered_set<T, H, E, A>> {
@@ -153,6 +322,10 @@ struct Memstat<std::unordered_set<T, H, E, A>> {
     size += set.bucket_count() * sizeof(void*);
     return size;
   }
+
+  static Memslack slack(const std::unordered_set<T, H, E, A>& set) {
+    return memslack_buckets(set, "unordered_set");
+  }
 };
 
 // std::map
@@ -160,8 +333,8 @@ template <typename K, typename V, typename C, typename A>
 struct Memstat<std::map<K, V, C, A>> {
   static size_t memstat(const std::map<K, V, C, A>& map) {
     size_t size = sizeof(std::map<K, V, C, A>);
-    for (const auto& [key, value] : map) {
-      size += Memstat<std::pair<const K, V>>::memstat({key, value});
+    for (const auto& item : map) {
+      size += Memstat<std::pair<const K, V>>::memstat(item);
       size += sizeof(void*) * 3;  // Left, right, parent pointers
     }
     return size;
@@ -180,6 +353,10 @@ struct Memstat<std::unordered_map<K, V, H, E, A>> {
     size += map.bucket_count() * sizeof(void*);
     return size;
   }
+
+  static Memslack slack(const std::unordered_map<K, V, H, E, A>& map) {
+    return memslack_buckets(map, "unordered_map");
+  }
 };
 
 // std::pair
@@ -207,28 +384,129 @@ struct Memstat<std::optional<T>> {
 template <typename T, typename C>
 struct Memstat<std::stack<T, C>> {
   static size_t memstat(const std::stack<T, C>& stack) {
-    return Memstat<C>::memstat(stack.c);
+    return Memstat<C>::memstat(stack.*(&Access::c));
+  }
+
+ private:
+  // the underlying container is protected, reach it through a derived class
+  struct Access : std::stack<T, C> {
+    using std::stack<T, C>::c;
+  };
+};
+
+// std::queue (just a container adapter)
+template <typename T, typename C>
+struct Memstat<std::queue<T, C>> {
+  static size_t memstat(const std::queue<T, C>& queue) {
+    return Memstat<C>::memstat(queue.*(&Access::c));
+  }
+
+ private:
+  struct Access : std::queue<T, C> {
+    using std::queue<T, C>::c;
+  };
+};
+
+// std::priority_queue (just a container adapter)
+template <typename T, typename C, typename Cmp>
+struct Memstat<std::priority_queue<T, C, Cmp>> {
+  static size_t memstat(const std::priority_queue<T, C, Cmp>& queue) {
+    return Memstat<C>::memstat(queue.*(&Access::c));
+  }
+
+ private:
+  struct Access : std::priority_queue<T, C, Cmp> {
+    using std::priority_queue<T, C, Cmp>::c;
+  };
+};
+
+// std::array
+template <typename T, size_t N>
+struct Memstat<std::array<T, N>> {
+  static size_t memstat(const std::array<T, N>& arr) {
+    size_t size = sizeof(std::array<T, N>);
+    for (const auto& elem : arr) size += Memstat<T>::memstat(elem) - sizeof(T);
+    return size;
+  }
+};
+
+// std::variant
+template <typename... Ts>
+struct Memstat<std::variant<Ts...>> {
+  static size_t memstat(const std::variant<Ts...>& var) {
+    size_t size = sizeof(std::variant<Ts...>);
+    if (var.valueless_by_exception()) return size;
+    size += std::visit(
+        [](const auto& alt) {
+          using Alt = std::decay_t<decltype(alt)>;
+          return Memstat<Alt>::memstat(alt) - sizeof(Alt);
+        },
+        var);
+    return size;
+  }
+};
+
+// std::unique_ptr (arrays and void are counted as the pointer only, their
+// size is unknown)
+template <typename T, typename D>
+struct Memstat<std::unique_ptr<T, D>> {
+  static size_t memstat(const std::unique_ptr<T, D>& ptr) {
+    size_t size = sizeof(std::unique_ptr<T, D>);
+    if constexpr (!std::is_void_v<T> && !std::is_array_v<T>)
+      if (ptr) size += Memstat<T>::memstat(*ptr);
+    return size;
+  }
+};
+
+// std::shared_ptr: the target and its control block (two counters and a
+// vptr) are counted by the first owner reached; arrays and void count the
+// control block only
+template <typename T>
+struct Memstat<std::shared_ptr<T>> {
+  static size_t memstat(const std::shared_ptr<T>& ptr) {
+    const MemstatScope scope;
+    size_t size = sizeof(std::shared_ptr<T>);
+    if (!ptr || !MemstatContext::first_visit(ptr.get())) return size;
+    size += 2 * sizeof(void*);
+    if constexpr (!std::is_void_v<T> && !std::is_array_v<T>)
+      size += Memstat<T>::memstat(*ptr);
+    return size;
   }
 };
 
 // Convenience macros for adding memstat to structures
+//
+// Besides memstat() they generate memstat_fields(visit), which calls
+// visit(name, field) for every listed field (see memstat_tree.h).
 #define MEMSTAT_FIELD(res, field) \
   size += ::memstat(field).nbytes - sizeof(field)
-#define INLINE_MEMSTAT(Type, fields...)                    \
-  size_t memstat() const {                                 \
-    size_t size = sizeof(Type);                            \
-    PP_FOREACH_LIST(PP_BIND(MEMSTAT_FIELD, size), fields); \
-    return size;                                           \
+#define MEMSTAT_VISIT_FIELD(visit, field) visit(#field, field)
+#define INLINE_MEMSTAT(Type, fields...)                                \
+  size_t memstat() const {                                             \
+    size_t size = sizeof(Type);                                        \
+    PP_FOREACH_LIST(PP_BIND(MEMSTAT_FIELD, size), fields);             \
+    return size;                                                       \
+  }                                                                    \
+  template <typename Visitor>                                          \
+  void memstat_fields([[maybe_unused]] Visitor&& visit) const {        \
+    PP_FOREACH_LIST(PP_BIND(MEMSTAT_VISIT_FIELD, visit), fields);      \
   }
 
 #define OBJ_MEMSTAT_FIELD(res, obj, field) \
   res += ::memstat(obj.field).nbytes - sizeof(obj.field)
-#define MEMSTAT_STRUCT(Type, fields...)                               \
-  template <>                                                         \
-  struct Memstat<Type> {                                              \
-    static size_t memstat(const Type& obj) {                          \
-      size_t size = sizeof(Type);                                     \
-      PP_FOREACH_LIST(PP_BIND(OBJ_MEMSTAT_FIELD, size, obj), fields); \
-      return size;                                                    \
-    }                                                                 \
+#define OBJ_MEMSTAT_VISIT_FIELD(visit, obj, field) visit(#field, obj.field)
+#define MEMSTAT_STRUCT(Type, fields...)                                    \
+  template <>                                                              \
+  struct Memstat<Type> {                                                   \
+    static size_t memstat(const Type& obj) {                               \
+      size_t size = sizeof(Type);                                          \
+      PP_FOREACH_LIST(PP_BIND(OBJ_MEMSTAT_FIELD, size, obj), fields);      \
+      return size;                                                         \
+    }                                                                      \
+    template <typename Visitor>                                            \
+    static void memstat_fields([[maybe_unused]] const Type& obj,           \
+                               [[maybe_unused]] Visitor&& visit) {         \
+      PP_FOREACH_LIST(PP_BIND(OBJ_MEMSTAT_VISIT_FIELD, visit, obj),        \
+                      fields);                                             \
+    }                                                                      \
   };
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "memstat.h"
+#include "memstat_tree.h"
+#include "pprint.h"
+#include "to_tuple.h"
+
+// Struct layout analysis: offsets, padding, cache line spans and a field
+// order that minimizes sizeof. The fields come from the MEMSTAT_STRUCT /
+// INLINE_MEMSTAT field list, or from to_tuple for aggregates without one
+// (unnamed, up to 10 members). A list missing members leaves gaps wider
+// than alignment padding; the layout is then reported without a reorder
+// hint, which would be too optimistic.
+
+static constexpr size_t memstat_cache_line = 64;
+
+struct FieldLayout {
+  const char* name;  // nullptr for members found by to_tuple
+  size_t index;      // position among the members found
+  size_t offset;
+  size_t size;
+  size_t align;
+
+  void print_name(std::ostream& os) const {
+    if (name)
+      os << "." << name;
+    else
+      os << "[" << index << "]";
+  }
+
+  size_t end() const { return offset + size; }
+  // cache lines touched, assuming the struct starts on a line boundary
+  size_t first_line() const { return offset / memstat_cache_line; }
+  size_t last_line() const {
+    return (offset + std::max<size_t>(size, 1) - 1) / memstat_cache_line;
+  }
+};
+
+struct StructLayout {
+  std::string name;
+  size_t size = 0;
+  size_t align = 0;
+  std::vector<FieldLayout> fields;  // by offset
+  std::vector<FieldLayout> packed;  // alignment-sorted, with new offsets
+  size_t packed_size = 0;
+  size_t count = 0;       // instances found
+  bool complete = false;  // fields cover all but alignment padding
+
+  size_t padding() const {
+    size_t used = 0;
+    for (const auto& field : fields) used += field.size;
+    return size - std::min(used, size);
+  }
+  size_t savings() const {
+    return complete ? size - std::min(packed_size, size) : 0;
+  }
+  size_t lines() const {
+    return (size + memstat_cache_line - 1) / memstat_cache_line;
+  }
+
+  void print(std::ostream& os) const {
+    os << name << ": " << size << " bytes, align " << align << ", "
+       << padding() << (complete ? " padding, " : " padding or unlisted, ")
+       << lines() << " cache lines\n";
+    os << "  offset  size align\n";
+    size_t end = 0;
+    for (const auto& field : fields) {
+      if (field.offset > end) print_padding(os, end, field.offset - end);
+      os << "  " << std::setw(6) << field.offset << std::setw(6) << field.size
+         << std::setw(6) << field.align << "  ";
+      field.print_name(os);
+      if (field.first_line() != field.last_line())
+        os << "  spans lines " << field.first_line() << "-"
+           << field.last_line();
+      os << "\n";
+      end = std::max(end, field.end());
+    }
+    if (size > end) print_padding(os, end, size - end);
+
+    if (!complete) {
+      os << "  members missing from the field list, no reorder hint\n";
+    } else if (savings() == 0) {
+      os << "  field order is optimal\n";
+    } else {
+      os << "  reorder:";
+      for (const auto& field : packed) {
+        os << " ";
+        field.print_name(os);
+      }
+      os << " -> " << packed_size << " bytes, saves " << savings()
+         << " per instance\n";
+    }
+    if (count != 1) {
+      os << "  " << count << " instances, " << Memsize{count * size};
+      if (savings()) os << ", reorder saves " << Memsize{count * savings()};
+      os << "\n";
+    }
+  }
+
+ private:
+  static void print_padding(std::ostream& os, size_t offset, size_t size) {
+    os << "  " << std::setw(6) << offset << std::setw(6) << size
+       << "        (padding)\n";
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StructLayout& layout) {
+  layout.print(os);
+  return os;
+}
+
+// Finds instances of S among val and everything memstat descends into
+template <typename S>
+class StructLayoutCollector {
+ public:
+  const S* first = nullptr;
+  size_t count = 0;
+
+  template <typename T>
+  void visit(const T& val) {
+    if constexpr (std::is_same_v<T, S>) {
+      if (!first) first = &val;
+      count++;
+    }
+    memstat_children(val, [this](const auto&, const auto& inner,
+                                 const MemstatLabel&) { visit(inner); });
+  }
+};
+
+template <typename S>
+std::vector<FieldLayout> struct_fields(const S& obj) {
+  std::vector<FieldLayout> fields;
+  const auto base = reinterpret_cast<const char*>(&obj);
+  const auto add = [&](const char* name, const auto& field) {
+    using F = std::remove_cv_t<std::remove_reference_t<decltype(field)>>;
+    const auto ptr = reinterpret_cast<const char*>(&field);
+    fields.push_back(
+        {name, fields.size(), size_t(ptr - base), sizeof(F), alignof(F)});
+  };
+  if constexpr (has_memstat_fields_method_v<S>) {
+    obj.memstat_fields(add);
+  } else if constexpr (has_memstat_fields_struct_v<S>) {
+    Memstat<S>::memstat_fields(obj, add);
+  } else if constexpr (std::is_aggregate_v<S> && !std::is_array_v<S>) {
+    // to_tuple binds up to 10 members
+    if constexpr (fields_count_v<S> > 0 && fields_count_v<S> <= 10)
+      std::apply([&](const auto&... field) { (add(nullptr, field), ...); },
+                 to_tuple(obj));
+  }
+  std::stable_sort(fields.begin(), fields.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.offset < b.offset;
+                   });
+  return fields;
+}
+
+// True if fields, sorted by offset, are where the compiler puts them when
+// they are all the members: anything else in between or after them takes
+// more than alignment padding
+inline bool covers_struct(const std::vector<FieldLayout>& fields,
+                          size_t size, size_t align) {
+  if (fields.empty()) return false;
+  size_t end = 0;
+  for (const auto& field : fields) {
+    if (field.offset != (end + field.align - 1) / field.align * field.align)
+      return false;
+    end = field.end();
+  }
+  return size == (end + align - 1) / align * align;
+}
+
+// Lays fields out by decreasing alignment, then size; returns sizeof
+inline size_t pack_fields(std::vector<FieldLayout>& fields, size_t align) {
+  std::stable_sort(fields.begin(), fields.end(),
+                   [](const auto& a, const auto& b) {
+                     if (a.align != b.align) return a.align > b.align;
+                     return a.size > b.size;
+                   });
+  size_t offset = 0;
+  for (auto& field : fields) {
+    offset = (offset + field.align - 1) / field.align * field.align;
+    field.offset = offset;
+    offset += field.size;
+  }
+  return (offset + align - 1) / align * align;
+}
+
+// Main function: layout of S, with the number of instances of S reachable
+// from root. S defaults to the type of root, e.g. struct_layout(obj) or
+// struct_layout<Record>(records).
+template <typename S = void, typename Root>
+StructLayout struct_layout(const Root& root) {
+  using Struct = std::conditional_t<std::is_void_v<S>, Root, S>;
+  StructLayoutCollector<Struct> collector;
+  collector.visit(root);
+
+  StructLayout layout;
+  layout.name = get_typename<Struct>();
+  layout.size = sizeof(Struct);
+  layout.align = alignof(Struct);
+  layout.count = collector.count;
+  if (collector.first) {
+    layout.fields = struct_fields(*collector.first);
+  } else if constexpr (std::is_default_constructible_v<Struct>) {
+    layout.fields = struct_fields(Struct{});
+  }
+  // the reorder hint assumes that the field list is complete
+  layout.complete = covers_struct(layout.fields, layout.size, layout.align);
+  layout.packed = layout.fields;
+  layout.packed_size = layout.fields.empty()
+                           ? layout.size
+                           : pack_fields(layout.packed, layout.align);
+  return layout;
+}
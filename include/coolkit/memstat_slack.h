@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memstat.h"
+#include "memstat_tree.h"
+
+// Wasted capacity analysis: splits memstat(val) into used and
+// reserved-but-unused bytes (vector/string capacity, empty hash buckets)
+// and lists the containers where shrink_to_fit/rehash would pay off.
+
+// Helper to detect if Memstat<T> reports container slack
+template <typename T, typename = void>
+struct has_memslack : std::false_type {};
+
+template <typename T>
+struct has_memslack<
+    T, std::void_t<decltype(Memstat<T>::slack(std::declval<const T&>()))>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool has_memslack_v = has_memslack<T>::value;
+
+struct MemslackOptions {
+  std::string name = "root";
+  // containers that would release less than this are only counted in totals
+  size_t min_bytes = 1024;
+  size_t max_entries = 20;
+};
+
+struct MemslackReport {
+  struct Entry {
+    std::string path;
+    Memslack slack;
+  };
+
+  std::string name;
+  size_t total = 0;        // memstat(val)
+  size_t unused = 0;       // reserved but unused, summed over containers
+  size_t recoverable = 0;  // released by applying every fix
+  size_t containers = 0;   // containers inspected
+  std::vector<Entry> entries;  // heaviest recoverable first
+
+  size_t used() const { return total - unused; }
+
+  void print(std::ostream& os) const {
+    os << name << ": " << Memsize{total} << " total, " << Memsize{used()}
+       << " used, " << Memsize{unused} << " unused ";
+    print_percent(os, unused);
+    os << ", " << Memsize{recoverable} << " recoverable in " << containers
+       << " containers\n";
+    for (const auto& entry : entries) {
+      const Memslack& slack = entry.slack;
+      os << "  " << entry.path << " " << slack.kind << ": "
+         << Memsize{slack.reserved} << " reserved, " << Memsize{slack.unused}
+         << " unused";
+      if (slack.empty_buckets) {
+        const long hundredths = std::lround(slack.load_factor * 100);
+        os << " (" << slack.empty_buckets << " empty buckets, load factor "
+           << hundredths / 100 << "." << hundredths % 100 / 10
+           << hundredths % 10 << ")";
+      }
+      os << " -> " << slack.fix << " frees " << Memsize{slack.recoverable}
+         << "\n";
+    }
+  }
+
+ private:
+  void print_percent(std::ostream& os, size_t nbytes) const {
+    const size_t permille = total ? (nbytes * 1000 + total / 2) / total : 0;
+    os << "(" << permille / 10 << "." << permille % 10 << "%)";
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const MemslackReport& rep) {
+  rep.print(os);
+  return os;
+}
+
+class MemslackCollector {
+  size_t min_bytes;
+  MemslackReport& report;
+  std::vector<MemstatLabel> path;
+
+  std::string path_str() const {
+    std::ostringstream ss;
+    ss << report.name;
+    for (const auto& label : path) label.print(ss);
+    return ss.str();
+  }
+
+ public:
+  MemslackCollector(MemslackReport& report, size_t min_bytes)
+      : min_bytes(min_bytes), report(report) {}
+
+  template <typename T>
+  void visit(const T& val) {
+    if constexpr (has_memslack_v<T>) {
+      const Memslack slack = Memstat<T>::slack(val);
+      report.containers++;
+      report.unused += slack.unused;
+      report.recoverable += slack.recoverable;
+      if (slack.recoverable && slack.recoverable >= min_bytes)
+        report.entries.push_back({path_str(), slack});
+    }
+    memstat_children(val, [this](const auto&, const auto& inner,
+                                 const MemstatLabel& label) {
+      path.push_back(label);
+      visit(inner);
+      path.pop_back();
+    });
+  }
+};
+
+// Main function
+template <typename T>
+MemslackReport memstat_slack(const T& val, MemslackOptions opts = {}) {
+  MemslackReport report;
+  report.name = std::move(opts.name);
+  report.total = ::memstat(val).nbytes;
+  MemslackCollector{report, opts.min_bytes}.visit(val);
+
+  auto& entries = report.entries;
+  const size_t count = std::min(opts.max_entries, entries.size());
+  std::partial_sort(entries.begin(), entries.begin() + count, entries.end(),
+                    [](const auto& a, const auto& b) {
+                      return a.slack.recoverable > b.slack.recoverable;
+                    });
+  entries.resize(count);
+  return report;
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memstat.h"
+#include "traits.h"
+
+// Hierarchical memstat: splits the total of memstat(val) by struct field
+// (MEMSTAT_STRUCT / INLINE_MEMSTAT lists), container element and map key.
+// Every node kept in the tree is measured in full, so building costs about
+// one memstat pass per level of kept nodes; pruned subtrees are measured
+// once and not descended.
+
+struct MemstatNode {
+  std::string name;
+  size_t nbytes = 0;
+  std::vector<MemstatNode> children;
+  // children below the pruning threshold, folded into one line
+  size_t pruned_count = 0;
+  size_t pruned_bytes = 0;
+};
+
+struct MemstatTreeOptions {
+  std::string name = "root";
+  // subtrees smaller than max(min_bytes, min_fraction * total) are pruned
+  size_t min_bytes = 0;
+  double min_fraction = 0.01;
+  size_t max_depth = 16;
+};
+
+// Helpers to detect field visitors generated by the memstat macros
+struct _memstat_null_visitor {
+  template <typename T>
+  void operator()(const char*, const T&) const {}
+};
+
+template <typename T, typename = void>
+struct has_memstat_fields_method : std::false_type {};
+
+template <typename T>
+struct has_memstat_fields_method<
+    T, std::void_t<decltype(std::declval<const T&>().memstat_fields(
+           _memstat_null_visitor{}))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct has_memstat_fields_struct : std::false_type {};
+
+template <typename T>
+struct has_memstat_fields_struct<
+    T, std::void_t<decltype(Memstat<T>::memstat_fields(
+           std::declval<const T&>(), _memstat_null_visitor{}))>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool has_memstat_fields_method_v =
+    has_memstat_fields_method<T>::value;
+template <typename T>
+constexpr bool has_memstat_fields_struct_v =
+    has_memstat_fields_struct<T>::value;
+
+// Types that never own memory outside of sizeof(T)
+template <typename T>
+constexpr bool is_flat_memstat_v = std::is_arithmetic_v<T> ||
+                                   std::is_enum_v<T> || std::is_pointer_v<T>;
+
+// Lazily formatted child label: ".field", "[index]" or "[key]"; "[#index]"
+// for map keys without an ostream operator
+struct MemstatLabel {
+  const char* field = nullptr;
+  size_t index = 0;
+  bool is_key = false;
+  const void* key = nullptr;
+  void (*format_key)(std::ostream&, const void*) = nullptr;
+
+  void print(std::ostream& os) const {
+    if (field) {
+      os << "." << field;
+    } else if (format_key) {
+      os << "[";
+      format_key(os, key);
+      os << "]";
+    } else {
+      os << (is_key ? "[#" : "[") << index << "]";
+    }
+  }
+
+  std::string str() const {
+    if (field) return std::string(".") + field;
+    if (!format_key)
+      return (is_key ? "[#" : "[") + std::to_string(index) + "]";
+    std::ostringstream ss;
+    print(ss);
+    return ss.str();
+  }
+
+  template <typename K>
+  static MemstatLabel of_key(const K& key, size_t index) {
+    MemstatLabel label;
+    label.index = index;
+    label.is_key = true;
+    if constexpr (has_ostream_operator_v<const K&>) {
+      label.key = &key;
+      label.format_key = [](std::ostream& os, const void* key) {
+        os << *static_cast<const K*>(key);
+      };
+    }
+    return label;
+  }
+};
+
+// Calls f(measured, inner, label) for every child of val: struct fields,
+// map items (measured as the whole item, descended through the mapped
+// value) and range elements that can own memory
+template <typename T, typename F>
+void memstat_children(const T& val, F&& f) {
+  if constexpr (has_memstat_fields_method_v<T>) {
+    val.memstat_fields([&f](const char* name, const auto& field) {
+      MemstatLabel label;
+      label.field = name;
+      f(field, field, label);
+    });
+  } else if constexpr (has_memstat_fields_struct_v<T>) {
+    Memstat<T>::memstat_fields(val, [&f](const char* name, const auto& field) {
+      MemstatLabel label;
+      label.field = name;
+      f(field, field, label);
+    });
+  } else if constexpr (is_map_like_v<T>) {
+    size_t index = 0;
+    for (const auto& item : val)
+      f(item, item.second, MemstatLabel::of_key(item.first, index++));
+  } else if constexpr (is_range_v<T> && !std::is_array_v<T>) {
+    using value_type = typename T::value_type;
+    if constexpr (!is_flat_memstat_v<value_type>) {
+      MemstatLabel label;
+      for (const auto& elem : val) {
+        f(elem, elem, label);
+        label.index++;
+      }
+    }
+  }
+}
+
+class MemstatTreeBuilder {
+  size_t threshold;
+  size_t max_depth;
+  size_t depth = 0;
+  MemstatNode* parent = nullptr;
+  PointerSet counted;  // shared targets charged to earlier nodes
+
+  // val is measured, inner is descended into (differs for map items); a
+  // shared target is charged to the first node in traversal order reaching
+  // it, its children are measured before it is marked counted
+  template <typename T, typename U>
+  void add(const T& val, const U& inner, const MemstatLabel& label) {
+    MemstatContext ctx{counted};
+    size_t nbytes;
+    {
+      const MemstatScope scope{ctx};
+      nbytes = ::memstat(val).nbytes;
+    }
+    if (nbytes < threshold || depth >= max_depth) {
+      parent->pruned_count++;
+      parent->pruned_bytes += nbytes;
+    } else {
+      parent->children.push_back({label.str(), nbytes, {}});
+      descend(parent->children.back(), inner);
+    }
+    ctx.commit();
+  }
+
+  template <typename T>
+  void descend(MemstatNode& node, const T& val) {
+    MemstatNode* const saved = parent;
+    parent = &node;
+    depth++;
+    memstat_children(val, [this](const auto& val, const auto& inner,
+                                 const MemstatLabel& label) {
+      add(val, inner, label);
+    });
+    depth--;
+    parent = saved;
+  }
+
+ public:
+  MemstatTreeBuilder(size_t threshold, size_t max_depth)
+      : threshold(threshold), max_depth(max_depth) {}
+
+  template <typename T>
+  MemstatNode build(const T& val, std::string name, size_t nbytes) {
+    MemstatNode root{std::move(name), nbytes, {}};
+    descend(root, val);
+    return root;
+  }
+};
+
+struct MemstatTree {
+  MemstatNode root;
+
+  struct Path {
+    std::string path;
+    size_t nbytes;
+  };
+
+  // Heaviest leaves of the (pruned) tree, with their full paths
+  std::vector<Path> top(size_t n) const {
+    std::vector<Path> paths;
+    collect(root, "", paths);
+    const size_t count = std::min(n, paths.size());
+    std::partial_sort(
+        paths.begin(), paths.begin() + count, paths.end(),
+        [](const Path& a, const Path& b) { return a.nbytes > b.nbytes; });
+    paths.resize(count);
+    return paths;
+  }
+
+  void print(std::ostream& os, size_t top_n = 10) const {
+    print_node(os, root, 0);
+    if (top_n == 0 || root.children.empty()) return;
+    const auto paths = top(top_n);
+    os << "top " << paths.size() << ":\n";
+    for (const auto& path : paths) {
+      os << "  " << path.path << " " << Memsize{path.nbytes} << " ";
+      print_percent(os, path.nbytes);
+      os << "\n";
+    }
+  }
+
+ private:
+  static void collect(const MemstatNode& node, const std::string& prefix,
+                      std::vector<Path>& paths) {
+    const std::string path = prefix + node.name;
+    if (node.children.empty()) return paths.push_back({path, node.nbytes});
+    for (const auto& child : node.children) collect(child, path, paths);
+  }
+
+  void print_percent(std::ostream& os, size_t nbytes) const {
+    const size_t permille =
+        root.nbytes ? (nbytes * 1000 + root.nbytes / 2) / root.nbytes : 0;
+    os << permille / 10 << "." << permille % 10 << "%";
+  }
+
+  void print_node(std::ostream& os, const MemstatNode& node,
+                  size_t level) const {
+    const std::string indent(level * 2, ' ');
+    os << indent << node.name << " " << Memsize{node.nbytes} << " ";
+    print_percent(os, node.nbytes);
+    os << "\n";
+    for (const auto& child : node.children) print_node(os, child, level + 1);
+    if (node.pruned_count) {
+      os << indent << "  ... " << node.pruned_count << " more "
+         << Memsize{node.pruned_bytes} << " ";
+      print_percent(os, node.pruned_bytes);
+      os << "\n";
+    }
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const MemstatTree& tree) {
+  tree.print(os);
+  return os;
+}
+
+// Main function
+template <typename T>
+MemstatTree memstat_tree(const T& val, MemstatTreeOptions opts = {}) {
+  const size_t total = ::memstat(val).nbytes;
+  const size_t threshold = std::max(
+      opts.min_bytes, static_cast<size_t>(opts.min_fraction * double(total)));
+  MemstatTreeBuilder builder{threshold, opts.max_depth};
+  return {builder.build(val, std::move(opts.name), total)};
+}
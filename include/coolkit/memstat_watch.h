@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "memstat.h"
+#include "pprint.h"
+
+// Periodic memstat sampling of long-lived objects (caches, indexes, queues)
+// on a background thread, to catch leaks and unbounded growth long before
+// the process runs out of memory, e.g.
+//
+//   MemstatWatcher watcher;
+//   const MemstatWatch watch =
+//       watcher.watch("sessions", sessions, {256 << 20, 1 << 20}, mutex);
+//   watcher.start();
+//   ...
+//   printout(watcher.report());
+//
+// Objects are registered through type-erased handles and sampled round
+// robin, a bounded number per tick, as memstat of a node-based container
+// walks every node. Each object keeps a fixed-size ring of samples,
+// allocated at registration, and is flagged once its size or its growth
+// over the ring passes its limits.
+//
+// An object changed by other threads must be registered with the lock that
+// guards it, which is held while it is sampled; its handle must not be
+// destroyed under that lock. Handles must not outlive the watcher.
+
+// Signed rate of change of a size, printed as "+1.20M/s"
+struct Memrate {
+  double bytes_per_second = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, Memrate rate) {
+  os << (rate.bytes_per_second < 0 ? "-" : "+")
+     << Memsize{size_t(std::abs(rate.bytes_per_second))} << "/s";
+  return os;
+}
+
+struct MemstatLimits {
+  size_t max_bytes = 0;   // flagged above, 0 for no limit
+  double max_growth = 0;  // bytes per second over a full ring, 0 for none
+};
+
+// The samples of one watched object
+struct MemstatTrend {
+  std::string name;
+  Memsize size;      // latest sample
+  Memsize peak;      // largest sample kept
+  Memrate growth;    // least-squares slope of the samples kept
+  size_t samples;    // kept, up to the history size
+  const char* flag;  // "size", "growth" or empty
+  INLINE_PRINT(MemstatTrend, name, size, peak, growth, samples, flag);
+};
+
+template <>
+struct is_memstattable<MemstatTrend> : std::false_type {};
+
+struct MemstatWatchOptions {
+  std::chrono::milliseconds interval{1000};  // between ticks
+  size_t objects_per_tick = 16;              // sampled per tick
+  size_t history = 64;                       // samples kept per object
+  // called on the sampling thread when an object becomes flagged
+  std::function<void(const MemstatTrend&)> on_flag;
+};
+
+class MemstatWatcher;
+
+// Registration of one object; stops the watching when destroyed
+class MemstatWatch {
+  MemstatWatcher* watcher = nullptr;
+  const void* entry = nullptr;
+
+ public:
+  MemstatWatch() = default;
+  MemstatWatch(MemstatWatcher* watcher, const void* entry)
+      : watcher(watcher), entry(entry) {}
+  ~MemstatWatch() { reset(); }
+  MemstatWatch(MemstatWatch&& other) noexcept
+      : watcher(std::exchange(other.watcher, nullptr)), entry(other.entry) {}
+  MemstatWatch& operator=(MemstatWatch&& other) noexcept {
+    if (this != &other) {
+      reset();
+      watcher = std::exchange(other.watcher, nullptr);
+      entry = other.entry;
+    }
+    return *this;
+  }
+
+  void reset();
+  explicit operator bool() const { return watcher; }
+};
+
+class MemstatWatcher {
+  struct Sample {
+    double time;  // seconds since the watcher was created
+    size_t nbytes;
+  };
+
+  struct Entry {
+    std::string name;
+    const void* val;
+    void* lock;  // nullptr if not guarded
+    size_t (*sample)(const void* val, void* lock);
+    MemstatLimits limits;
+    std::unique_ptr<Sample[]> ring;
+    size_t next = 0;  // slot of the next sample
+    size_t count = 0;
+    bool flagged = false;
+  };
+
+  MemstatWatchOptions opts;
+  const std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  std::mutex mutex;  // entries and their samples
+  std::vector<std::unique_ptr<Entry>> entries;
+  size_t cursor = 0;  // next entry to sample
+
+  std::thread thread;
+  std::mutex control;
+  std::condition_variable wake;
+  bool stopping = false;
+
+  friend class MemstatWatch;
+
+  template <typename T>
+  static size_t sample_unguarded(const void* val, void*) {
+    return ::memstat(*static_cast<const T*>(val)).nbytes;
+  }
+
+  template <typename T, typename Lock>
+  static size_t sample_guarded(const void* val, void* lock) {
+    const std::lock_guard<Lock> guard(*static_cast<Lock*>(lock));
+    return ::memstat(*static_cast<const T*>(val)).nbytes;
+  }
+
+  MemstatWatch add(std::string name, const void* val, void* lock,
+                   size_t (*sample)(const void*, void*),
+                   MemstatLimits limits) {
+    auto entry = std::make_unique<Entry>();
+    entry->name = std::move(name);
+    entry->val = val;
+    entry->lock = lock;
+    entry->sample = sample;
+    entry->limits = limits;
+    entry->ring.reset(new Sample[history()]);
+    const std::lock_guard<std::mutex> guard(mutex);
+    entries.push_back(std::move(entry));
+    return {this, entries.back().get()};
+  }
+
+  void remove(const void* entry) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (entries[i].get() != entry) continue;
+      entries[i] = std::move(entries.back());
+      entries.pop_back();
+      return;
+    }
+  }
+
+  size_t history() const { return std::max<size_t>(opts.history, 2); }
+
+  double seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         epoch)
+        .count();
+  }
+
+  // least-squares slope of the samples, in bytes per second
+  double growth(const Entry& entry) const {
+    if (entry.count < 2) return 0;
+    double time = 0, nbytes = 0;
+    for (size_t i = 0; i < entry.count; ++i) {
+      time += entry.ring[i].time;
+      nbytes += double(entry.ring[i].nbytes);
+    }
+    time /= double(entry.count);
+    nbytes /= double(entry.count);
+    double covariance = 0, variance = 0;
+    for (size_t i = 0; i < entry.count; ++i) {
+      const double dt = entry.ring[i].time - time;
+      covariance += dt * (double(entry.ring[i].nbytes) - nbytes);
+      variance += dt * dt;
+    }
+    return variance > 0 ? covariance / variance : 0;
+  }
+
+  const Sample& latest(const Entry& entry) const {
+    return entry.ring[(entry.next + history() - 1) % history()];
+  }
+
+  // growth is judged over a full ring only, so warming up is not a leak
+  const char* check(const Entry& entry) const {
+    if (!entry.count) return "";
+    if (entry.limits.max_bytes && latest(entry).nbytes > entry.limits.max_bytes)
+      return "size";
+    if (entry.limits.max_growth && entry.count == history() &&
+        growth(entry) > entry.limits.max_growth)
+      return "growth";
+    return "";
+  }
+
+  MemstatTrend trend(const Entry& entry) const {
+    MemstatTrend trend{entry.name, {}, {}, {growth(entry)}, entry.count,
+                       check(entry)};
+    if (entry.count) trend.size = Memsize{latest(entry).nbytes};
+    for (size_t i = 0; i < entry.count; ++i)
+      trend.peak.nbytes = std::max(trend.peak.nbytes, entry.ring[i].nbytes);
+    return trend;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(control);
+    while (!wake.wait_for(lock, opts.interval, [&] { return stopping; })) {
+      lock.unlock();
+      tick();
+      lock.lock();
+    }
+  }
+
+ public:
+  explicit MemstatWatcher(MemstatWatchOptions opts = {})
+      : opts(std::move(opts)) {}
+  ~MemstatWatcher() { stop(); }
+  MemstatWatcher(const MemstatWatcher&) = delete;
+  MemstatWatcher& operator=(const MemstatWatcher&) = delete;
+
+  // Watches val, which must outlive the handle and only change on this
+  // thread or while the sampling thread is stopped
+  template <typename T>
+  MemstatWatch watch(std::string name, const T& val,
+                     MemstatLimits limits = {}) {
+    return add(std::move(name), &val, nullptr, &sample_unguarded<T>, limits);
+  }
+
+  // Watches val, sampled while holding lock
+  template <typename T, typename Lock>
+  MemstatWatch watch(std::string name, const T& val, MemstatLimits limits,
+                     Lock& lock) {
+    return add(std::move(name), &val, &lock, &sample_guarded<T, Lock>,
+               limits);
+  }
+
+  // Samples the next objects_per_tick objects in turn; called by the
+  // sampling thread, or by hand when it is not started
+  void tick() {
+    std::vector<MemstatTrend> flagged;
+    {
+      const std::lock_guard<std::mutex> guard(mutex);
+      const size_t count = std::min(opts.objects_per_tick, entries.size());
+      for (size_t i = 0; i < count; ++i) {
+        if (cursor >= entries.size()) cursor = 0;
+        Entry& entry = *entries[cursor++];
+        const double time = seconds();
+        entry.ring[entry.next] = {time, entry.sample(entry.val, entry.lock)};
+        entry.next = (entry.next + 1) % history();
+        entry.count = std::min(entry.count + 1, history());
+        const bool was_flagged = std::exchange(entry.flagged, *check(entry));
+        if (entry.flagged && !was_flagged && opts.on_flag)
+          flagged.push_back(trend(entry));
+      }
+    }
+    // outside the lock, so the callback may ask for a report
+    for (const auto& trend : flagged) opts.on_flag(trend);
+  }
+
+  // Ticks every interval on a background thread until stop()
+  void start() {
+    if (thread.joinable()) return;
+    stopping = false;
+    thread = std::thread([this] { run(); });
+  }
+
+  void stop() {
+    if (!thread.joinable()) return;
+    {
+      const std::lock_guard<std::mutex> guard(control);
+      stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+  }
+
+  size_t size() {
+    const std::lock_guard<std::mutex> guard(mutex);
+    return entries.size();
+  }
+
+  // Every watched object, flagged ones first, then largest first
+  std::vector<MemstatTrend> report() {
+    std::vector<MemstatTrend> trends;
+    {
+      const std::lock_guard<std::mutex> guard(mutex);
+      trends.reserve(entries.size());
+      for (const auto& entry : entries) trends.push_back(trend(*entry));
+    }
+    std::stable_sort(trends.begin(), trends.end(),
+                     [](const MemstatTrend& a, const MemstatTrend& b) {
+                       if (*a.flag != *b.flag) return *a.flag != 0;
+                       return a.size.nbytes > b.size.nbytes;
+                     });
+    return trends;
+  }
+};
+
+inline void MemstatWatch::reset() {
+  if (watcher) std::exchange(watcher, nullptr)->remove(entry);
+}
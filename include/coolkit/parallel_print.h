@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ansi.h"
+#include "pprint.h"
+
+// Parallel rendering of large random-access ranges: the elements are split
+// into chunks, each chunk is printed on a worker into its own buffer and
+// the buffers are written in order. The output is the same as print().
+
+// Thread pool running batches of indexed tasks. Every participant owns a
+// slice of the indices and takes them from the front; once its slice is
+// empty it steals from the back of the others. The calling thread
+// participates, so a pool without workers runs batches serially.
+class WorkStealingPool {
+  struct alignas(64) Queue {
+    std::mutex mutex;
+    size_t generation = 0;  // batch of the indices
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<Queue[]> queues;  // one per participant, the caller last
+  std::mutex batch;                 // one run() at a time
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  const std::function<void(size_t)>* task = nullptr;
+  size_t generation = 0;
+  size_t remaining = 0;      // tasks of the batch not finished
+  size_t active = 0;         // workers inside the batch
+  std::exception_ptr error;  // first exception of the batch
+  bool stopping = false;
+
+  // a worker that woke late for a finished batch finds the queues of the
+  // next one and must not take from them
+  bool pop(size_t self, size_t current, size_t& index) {
+    Queue& queue = queues[self];
+    const std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.generation != current || queue.begin == queue.end) return false;
+    index = queue.begin++;
+    return true;
+  }
+
+  bool steal(size_t self, size_t current, size_t& index) {
+    const size_t n = size();
+    for (size_t i = 1; i < n; ++i) {
+      Queue& queue = queues[(self + i) % n];
+      const std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.generation != current || queue.begin == queue.end) continue;
+      index = --queue.end;
+      return true;
+    }
+    return false;
+  }
+
+  // a throwing task still counts as finished, so the batch completes and
+  // run() rethrows its exception; f is only called for indices of its batch,
+  // it may be gone once they are done
+  void work(size_t self, size_t current, const std::function<void(size_t)>* f) {
+    size_t index, finished = 0;
+    std::exception_ptr caught;
+    while (pop(self, current, index) || steal(self, current, index)) {
+      try {
+        (*f)(index);
+      } catch (...) {
+        if (!caught) caught = std::current_exception();
+      }
+      finished++;
+    }
+    const std::lock_guard<std::mutex> lock(mutex);
+    remaining -= finished;
+    if (caught && !error) error = caught;
+  }
+
+  void worker(size_t self) {
+    size_t seen = 0;
+    for (;;) {
+      const std::function<void(size_t)>* f;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        f = task;
+        active++;
+      }
+      work(self, seen, f);
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (--active == 0) idle.notify_all();
+    }
+  }
+
+ public:
+  // threads workers besides the caller
+  explicit WorkStealingPool(size_t threads)
+      : queues(new Queue[threads + 1]) {
+    for (size_t i = 0; i < threads; ++i)
+      workers.emplace_back([this, i] { worker(i); });
+  }
+  ~WorkStealingPool() {
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : workers) thread.join();
+  }
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  // participants: the workers and the caller
+  size_t size() const { return workers.size() + 1; }
+
+  // Calls f(i) for every i below count and returns when all are done.
+  // Tasks must not call run() on the same pool. If tasks throw, the other
+  // tasks still run and the first exception is rethrown.
+  void run(size_t count, const std::function<void(size_t)>& f) {
+    if (count == 0) return;
+    const std::lock_guard<std::mutex> guard(batch);
+    const size_t n = size();
+    size_t current;
+    {
+      // the task, its generation and its indices are published together
+      const std::lock_guard<std::mutex> lock(mutex);
+      current = ++generation;
+      task = &f;
+      remaining = count;
+      for (size_t i = 0; i < n; ++i) {
+        const std::lock_guard<std::mutex> queue_lock(queues[i].mutex);
+        queues[i].generation = current;
+        queues[i].begin = i * count / n;
+        queues[i].end = (i + 1) * count / n;
+      }
+    }
+    wake.notify_all();
+    work(n - 1, current, &f);
+    // the tasks are done once the caller runs out of work, but workers may
+    // still be looking for more; the next batch must not reach them
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [&] { return remaining == 0 && active == 0; });
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+  }
+};
+
+// Shared pool of print_parallel, one participant per hardware thread
+inline WorkStealingPool& print_pool() {
+  static WorkStealingPool pool{
+      std::max(std::thread::hardware_concurrency(), 1u) - 1};
+  return pool;
+}
+
+// Ranges with fewer elements are printed serially
+inline constexpr size_t parallel_print_threshold = 4096;
+
+template <typename T, typename = void>
+struct is_parallel_printable : std::false_type {};
+
+template <typename T>
+struct is_parallel_printable<
+    T, std::enable_if_t<is_range_v<T> && !is_string_like_v<T> &&
+                        !is_byte_range_v<T>>>
+    : std::is_base_of<std::random_access_iterator_tag,
+                      typename std::iterator_traits<decltype(std::begin(
+                          std::declval<const T&>()))>::iterator_category> {};
+
+template <typename T>
+constexpr bool is_parallel_printable_v = is_parallel_printable<T>::value;
+
+// The range printer with its elements rendered on the pool. Width layouts,
+// summaries, collapsed runs and followed pointers are printed serially.
+template <typename T>
+void print_parallel_impl(PrintContext ctx, const T& range,
+                         WorkStealingPool& pool, size_t threshold) {
+  using value_type =
+      typename std::iterator_traits<decltype(std::begin(range))>::value_type;
+  const auto begin = std::begin(range);
+  const size_t size = size_t(std::distance(begin, std::end(range)));
+  const bool summary = std::is_arithmetic_v<value_type> && ctx.summarize &&
+                       size > ctx.summarize;
+  if (size < threshold || pool.size() == 1 || ctx.width || summary ||
+      ctx.collapse || ctx.follow_pointers)
+    return print_impl(ctx, range);
+
+  static constexpr bool is_small =
+      is_small_type_v<value_type> && !is_map_like_v<T>;
+  PunctuatorSet punct = has_keys_v<T> ? punct::keylist : punct::dynlist;
+  apply_layout(ctx, punct, layout_inline(ctx, range, is_small));
+
+  // a few chunks per participant, so stealing evens out uneven elements
+  const size_t nchunks = std::min(size, pool.size() * 8);
+  std::vector<std::string> chunks(nchunks);
+  const ansi::ColorMode mode = ansi::color_mode(ctx.os);
+  pool.run(nchunks, [&](size_t chunk) {
+    std::ostringstream os;
+    os.copyfmt(ctx.os);
+    ansi::set_color_mode(os, mode);
+    PrintContext local{os, ctx};
+    local.depth = ctx.depth;
+    {
+      const indentos indent{os, false};
+      const size_t first = chunk * size / nchunks;
+      const size_t last = (chunk + 1) * size / nchunks;
+      for (size_t i = first; i < last; ++i) {
+        if (i != 0) os << punct.sep;
+        os << punct.split;
+        print_element<T>(local, begin + i);
+      }
+    }
+    chunks[chunk] = os.str();
+  });
+
+  ctx.os << punct.start;
+  bool newline = false;
+  for (const auto& chunk : chunks) {
+    // the indentation a single indentos would add across chunks
+    if (newline && !chunk.empty() && chunk[0] != '\n') ctx.os << "  ";
+    ctx.os << chunk;
+    if (!chunk.empty()) newline = chunk.back() == '\n';
+  }
+  ctx.os << punct.split << punct.end;
+  if (ctx.memstat) print_memstat(ctx, range);
+}
+
+// Same as print(), large random-access ranges are rendered on the pool
+template <typename T>
+void print_parallel(std::ostream& os, const T& val,
+                    const PrintOptions& opts = {},
+                    WorkStealingPool& pool = print_pool(),
+                    size_t threshold = parallel_print_threshold) {
+  if (!is_sink_enabled(os)) return;
+  PrintContext ctx{os, opts};
+  if constexpr (is_parallel_printable_v<T>)
+    print_parallel_impl(ctx, val, pool, threshold);
+  else
+    print_impl(ctx, val);
+}
+
+template <typename T>
+std::string stringify_parallel(const T& val, const PrintOptions& opts = {},
+                               WorkStealingPool& pool = print_pool(),
+                               size_t threshold = parallel_print_threshold) {
+  std::stringstream ss;
+  print_parallel(ss, val, opts, pool, threshold);
+  return ss.str();
+}
@@ -7,26 +7,45 @@
 #include <cxxabi.h>
 #endif
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "ansi.h"
 #include "indentos.h"
 #include "macro.h"
 #include "memstat.h"
+#include "traits.h"
+#include "widthbuf.h"
 
 namespace Theme {
 #ifdef PPRINT_COLORS
-static constexpr auto color_typename = ansi::fg::rgb(0x4EC9B0);
-static constexpr auto color_number = ansi::fg::rgb(0xB5CEA8);
-static constexpr auto color_string = ansi::fg::rgb(0xCE9178);
-static constexpr auto color_constant = ansi::fg::rgb(0x4FC1FF);
-static constexpr auto color_variable = ansi::fg::rgb(0x9CDCFE);
-static constexpr auto color_memstat = ansi::fg::rgb(0x2D2D2E);
-// static constexpr auto color_function = ansi::fg::rgb(0xDCDCAA);
-// static constexpr auto color_inactive_function = ansi::fg::rgb(0x8D8D6F);
-static constexpr auto color_reset = ansi::fg::deflt;
+// downgraded per stream to what its terminal supports, see ansi::color_mode
+using Color = ansi::Adaptive;
+static constexpr Color color_typename = ansi::fg::rgb(0x4EC9B0);
+static constexpr Color color_number = ansi::fg::rgb(0xB5CEA8);
+static constexpr Color color_string = ansi::fg::rgb(0xCE9178);
+static constexpr Color color_constant = ansi::fg::rgb(0x4FC1FF);
+static constexpr Color color_variable = ansi::fg::rgb(0x9CDCFE);
+static constexpr Color color_memstat = ansi::fg::rgb(0x2D2D2E);
+// static constexpr Color color_function = ansi::fg::rgb(0xDCDCAA);
+// static constexpr Color color_inactive_function = ansi::fg::rgb(0x8D8D6F);
+static constexpr Color color_reset = ansi::fg::deflt;
+
+constexpr std::string_view str(const Color& color, ansi::ColorMode mode) {
+  return color.str(mode);
+}
 #else
 static constexpr auto color_typename = "";
 static constexpr auto color_number = "";
@@ -35,6 +54,10 @@ static constexpr auto color_constant = "";
 static constexpr auto color_variable = "";
 static constexpr auto color_memstat = "";
 static constexpr auto color_reset = "";
+
+constexpr std::string_view str(const char* color, ansi::ColorMode) {
+  return color;
+}
 #endif
 }  // namespace Theme
 
@@ -50,19 +73,6 @@ struct has_print_method<T, std::void_t<decltype(std::declval<T>().print(
 template <typename T>
 constexpr bool has_print_method_v = has_print_method<T>::value;
 
-// Helper to detect if type has ostream operator
-template <typename T, typename = void>
-struct has_ostream_operator : std::false_type {};
-
-template <typename T>
-struct has_ostream_operator<
-    T,
-    std::void_t<decltype(std::declval<std::ostream&>() << std::declval<T>())>>
-    : std::true_type {};
-
-template <typename T>
-constexpr bool has_ostream_operator_v = has_ostream_operator<T>::value;
-
 // Helper to detect string-like types
 template <typename T>
 struct is_string_like : std::is_constructible<std::string_view, T> {};
@@ -92,43 +102,118 @@ std::string get_typename() {
   return result;
 }
 
-struct PrintContext {
-  PrintContext(std::ostream& os) : os(os) {}
+struct PrintOptions {
   bool colors = true;
   bool multiline = true;
   bool quotes = false;
   bool memstat = true;
+  // line width for layout; 0 splits every value with non-small elements
+  size_t width = 0;
+  // bytes shown of a byte range, 0 for all
+  size_t blob_limit = 4096;
+  // arithmetic ranges longer than this print as statistics with their
+  // first and last summary_items elements, 0 prints every element
+  size_t summarize = 0;
+  size_t summary_items = 8;
+  // runs of at least this many equal adjacent elements print once, as
+  // "0 ×4096"; 0 prints every element
+  size_t collapse = 0;
+  // unprintable values show their demangled type name; off, the mangled
+  // name is shown without allocating
+  bool demangle = true;
+  // pointees of raw and smart pointers print in place of the address; one
+  // reachable through several pointers prints once, labelled "#1", and
+  // later as "&1", so cycles terminate. Pointees more than 16 pointers deep
+  // print as "&1" too, with "#1 ..." after the value, so long chains
+  // don't exhaust the stack.
+  bool follow_pointers = false;
+};
+
+class PrintLayout;
+class PointerLabels;
+
+struct PrintContext : PrintOptions {
+  PrintContext(std::ostream& os) : os(os) {}
+  PrintContext(std::ostream& os, const PrintOptions& opts)
+      : PrintOptions(opts), os(os) {}
   std::ostream& os;
+  size_t depth = 0;                   // indentation level
+  PrintLayout* layout = nullptr;      // set while printing with a width
+  PointerLabels* pointers = nullptr;  // set while following pointers
+
+  // columns left after the indentation
+  size_t line_width() const {
+    const size_t indent = 2 * depth;
+    return width > indent ? width - indent : 0;
+  }
 };
 
+// Helper to detect print methods generated by INLINE_PRINT
+template <typename T, typename = void>
+struct has_context_print_method : std::false_type {};
+
+template <typename T>
+struct has_context_print_method<
+    T, std::void_t<decltype(std::declval<T>().print(
+           std::declval<PrintContext&>()))>> : std::true_type {};
+
+template <typename T>
+constexpr bool has_context_print_method_v = has_context_print_method<T>::value;
+
+// Same output as std::quoted, without its temporary string stream
+inline void write_quoted(std::ostream& os, std::string_view str) {
+  os.put('"');
+  size_t start = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (str[i] == '"' || str[i] == '\\') {
+      os.write(str.data() + start, i - start);
+      os.put('\\');
+      start = i;
+    }
+  }
+  os.write(str.data() + start, str.size() - start);
+  os.put('"');
+}
+
+// Output of the base printer
+template <typename T>
+void print_default(PrintContext ctx, const T& val) {
+  if constexpr (has_context_print_method_v<T>) {
+    val.print(ctx);
+  } else if constexpr (has_print_method_v<T>) {
+    val.print(ctx.os);
+  } else if constexpr (is_string_like_v<T>) {
+    if (ctx.colors) ctx.os << Theme::color_string;
+    if (ctx.quotes)
+      write_quoted(ctx.os, val);
+    else
+      ctx.os << val;
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  } else if constexpr (std::is_enum_v<T>) {
+    if (ctx.colors) ctx.os << Theme::color_constant;
+    ctx.os << val;
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  } else if constexpr (has_ostream_operator_v<T>) {
+    if (std::is_integral_v<T> || std::is_floating_point_v<T>)
+      if (ctx.colors) ctx.os << Theme::color_number;
+    ctx.os << val;
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  } else {
+    if (ctx.colors) ctx.os << Theme::color_typename;
+    if (ctx.demangle)
+      ctx.os << get_typename<T>();
+    else
+      ctx.os << typeid(T).name();
+    if (ctx.colors) ctx.os << Theme::color_reset;
+    ctx.os << "{}";
+  }
+}
+
 // Base printer template
 template <typename T, typename = void>
 struct Printer {
   static void print(PrintContext ctx, const T& val) {
-    if constexpr (has_print_method_v<T>) {
-      val.print(ctx.os);
-    } else if constexpr (is_string_like_v<T>) {
-      if (ctx.colors) ctx.os << Theme::color_string;
-      if (ctx.quotes)
-        ctx.os << std::quoted(val);
-      else
-        ctx.os << val;
-      if (ctx.colors) ctx.os << Theme::color_reset;
-    } else if constexpr (std::is_enum_v<T>) {
-      if (ctx.colors) ctx.os << Theme::color_constant;
-      ctx.os << val;
-      if (ctx.colors) ctx.os << Theme::color_reset;
-    } else if constexpr (has_ostream_operator_v<T>) {
-      if (std::is_integral_v<T> || std::is_floating_point_v<T>)
-        if (ctx.colors) ctx.os << Theme::color_number;
-      ctx.os << val;
-      if (ctx.colors) ctx.os << Theme::color_reset;
-    } else {
-      if (ctx.colors) ctx.os << Theme::color_typename;
-      ctx.os << get_typename<T>();
-      if (ctx.colors) ctx.os << Theme::color_reset;
-      ctx.os << "{}";
-    }
+    print_default(ctx, val);
   }
 };
 
@@ -151,16 +236,362 @@ void print_memstat(PrintContext ctx, const T& val) {
   }
 }
 
+// Values whose flat width is memoized by address: composites that outlive
+// the print call
+template <typename T, typename = void>
+struct is_layout_cached : std::bool_constant<!is_small_type_v<T>> {};
+
+template <typename T>
+constexpr bool is_layout_cached_v = is_layout_cached<T>::value;
+
+template <typename T>
+void print_impl(PrintContext ctx, const T& val);
+template <typename T>
+void print_value(PrintContext ctx, const T& val);
+
+// Flat widths measured during one print call with a width. A measurement
+// also records the widths of the nested values it completed, so laying out
+// a value that did not fit does not render its children again.
+class PrintLayout {
+  struct Key {
+    const void* obj;
+    const void* type;
+    bool operator==(const Key& other) const {
+      return obj == other.obj && type == other.type;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      const std::hash<const void*> hash;
+      return hash(key.obj) * 31 + hash(key.type);
+    }
+  };
+  // exact width, or a lower bound if measuring stopped early
+  struct Width {
+    size_t size;
+    bool exact;
+  };
+
+  template <typename T>
+  static constexpr char type_tag = 0;
+
+  template <typename T>
+  static Key key(const T& val) {
+    return {&val, &type_tag<T>};
+  }
+
+  widthbuf meter;
+  std::ostream os{&meter};
+  bool measuring = false;
+  std::unordered_map<Key, Width, KeyHash> widths;
+
+ public:
+  // meter position before printing a nested value
+  size_t mark() const { return measuring ? meter.size() : 0; }
+  bool is_measuring() const { return measuring; }
+
+  template <typename T>
+  void record(const T& val, size_t start) {
+    if constexpr (is_layout_cached_v<T>)
+      if (measuring && !meter.overflowed())
+        widths[key(val)] = {meter.size() - start, true};
+  }
+
+  // Width of val printed on one line; above limit if it does not fit
+  template <typename T>
+  size_t flat_width(const PrintContext& ctx, const T& val, size_t limit) {
+    if constexpr (is_layout_cached_v<T>) {
+      const auto it = widths.find(key(val));
+      if (it != widths.end() && (it->second.exact || it->second.size > limit))
+        return it->second.size;
+    }
+    meter.reset(limit);
+    os.clear();
+    PrintContext flat{os, ctx};
+    flat.colors = false;
+    flat.multiline = false;
+    flat.layout = this;
+    flat.pointers = ctx.pointers;
+    measuring = true;
+    ::print_impl(flat, val);
+    measuring = false;
+    if constexpr (is_layout_cached_v<T>)
+      if (meter.overflowed()) widths[key(val)] = {meter.size(), false};
+    return meter.size();
+  }
+};
+
+// Raw and smart pointers to single objects; char pointers are strings
+template <typename T>
+struct is_followed_pointer
+    : std::bool_constant<std::is_pointer_v<T> && !is_string_like_v<T> &&
+                         std::is_object_v<std::remove_pointer_t<T>> &&
+                         !std::is_void_v<std::remove_pointer_t<T>>> {};
+
+template <typename T, typename D>
+struct is_followed_pointer<std::unique_ptr<T, D>>
+    : std::bool_constant<!std::is_array_v<T>> {};
+
+template <typename T>
+struct is_followed_pointer<std::shared_ptr<T>>
+    : std::bool_constant<!std::is_array_v<T>> {};
+
+template <typename T>
+constexpr bool is_followed_pointer_v = is_followed_pointer<T>::value;
+
+// Values tracked by follow_pointers besides pointees, so pointers to them
+// print as labels: composites that outlive the print call, like the layout
+// cache, other than strings and smart pointers
+template <typename T>
+struct is_pointer_target
+    : std::bool_constant<std::is_class_v<T> && is_layout_cached_v<T> &&
+                         !is_string_like_v<T> && !is_followed_pointer_v<T>> {};
+
+template <typename T>
+constexpr bool is_pointer_target_v = is_pointer_target<T>::value;
+
+// Objects reached during one print call with follow_pointers: pointees and
+// the class values they may point to. A first pass over the value counts
+// the ways to reach every object; the printing pass labels those with more
+// than one. Pointees nested too deeply are queued, both passes work through
+// the queue once the value is done.
+class PointerLabels {
+  struct Entry {
+    const void* obj;
+    const void* type;
+    uint32_t count;    // times reached in the counting pass
+    uint32_t id;       // label, 0 if none yet
+    bool printed;      // by the printing pass
+    bool on_path;      // being measured for a width layout
+  };
+
+  // output of the counting pass is dropped
+  class nullbuf : public std::streambuf {
+   protected:
+    virtual int overflow(int ch) { return traits_type::not_eof(ch); }
+    virtual std::streamsize xsputn(const char*, std::streamsize n) {
+      return n;
+    }
+  };
+
+  template <typename T>
+  static constexpr char type_tag = 0;
+
+  // queued pointee, printed by a thunk of its type
+  struct Pending {
+    const void* obj;
+    const void* type;
+    void (*print)(PrintContext& ctx, const void* obj);
+  };
+
+  // pointer hops printed in place before queueing, each nests a few
+  // printer calls
+  static constexpr size_t max_hops = 16;
+
+  std::vector<Entry> slots;
+  size_t size = 0;
+  uint32_t ids = 0;
+  bool counting = false;
+  size_t hops = 0;  // pointees being printed in place
+  std::vector<Pending> pending;
+  // innermost object being printed
+  const void* current_obj = nullptr;
+  const void* current_type = nullptr;
+
+  nullbuf sink;
+  std::ostream null{&sink};
+
+  static size_t hash(const void* obj, const void* type) {
+    uint64_t x = reinterpret_cast<uintptr_t>(obj) ^
+                 reinterpret_cast<uintptr_t>(type) << 7;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+  }
+
+  void grow() {
+    std::vector<Entry> old(slots.empty() ? 64 : slots.size() * 2);
+    old.swap(slots);
+    for (const Entry& entry : old)
+      if (entry.obj) *insert(entry.obj, entry.type) = entry;
+  }
+
+  // the entry of obj, a new one if absent; moves on insertions
+  Entry* insert(const void* obj, const void* type) {
+    if ((size + 1) * 2 > slots.size()) grow();
+    const size_t mask = slots.size() - 1;
+    for (size_t i = hash(obj, type) & mask;; i = (i + 1) & mask) {
+      Entry& entry = slots[i];
+      if (entry.obj == obj && entry.type == type) return &entry;
+      if (!entry.obj) {
+        entry = {obj, type, 0, 0, false, false};
+        size++;
+        return &entry;
+      }
+    }
+  }
+
+  static void print_label(PrintContext& ctx, char mark, uint32_t id) {
+    if (ctx.colors) ctx.os << Theme::color_constant;
+    ctx.os << mark << id;
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  }
+
+  // the body of a queued pointee, laid out on its own
+  template <typename T>
+  static void print_pending(PrintContext& ctx, const void* obj) {
+    const T& val = *static_cast<const T*>(obj);
+    if (!ctx.width) return ::print_value(ctx, val);
+    PrintLayout layout;
+    ctx.layout = &layout;
+    ::print_value(ctx, val);
+  }
+
+  // queues a pointee reached too deep; the printing pass shows its label
+  template <typename T>
+  void defer(PrintContext& ctx, const T& val) {
+    const void* type = &type_tag<T>;
+    Entry* entry = insert(&val, type);
+    if (counting) {
+      if (entry->count++ == 0)
+        pending.push_back({&val, type, &print_pending<T>});
+      return;
+    }
+    if (ctx.layout && ctx.layout->is_measuring())
+      return print_label(ctx, '&', entry->id ? entry->id : ids + 1);
+    if (!entry->printed) {
+      entry->printed = true;
+      entry->id = ++ids;
+      pending.push_back({&val, type, &print_pending<T>});
+    }
+    print_label(ctx, '&', entry->id);
+  }
+
+  // prints the queue, which grows while it is printed
+  void drain(PrintContext& ctx) {
+    for (size_t i = 0; i < pending.size(); ++i) {
+      const Pending item = pending[i];
+      if (!counting) {
+        ctx.os << "\n";
+        print_label(ctx, '#', insert(item.obj, item.type)->id);
+        ctx.os << " ";
+      }
+      current_obj = item.obj;
+      current_type = item.type;
+      item.print(ctx, item.obj);
+    }
+    pending.clear();
+    current_obj = current_type = nullptr;
+  }
+
+ public:
+  // The counting pass
+  template <typename T>
+  void count(const PrintContext& ctx, const T& val) {
+    PrintContext pass{null, ctx};
+    pass.colors = false;
+    pass.memstat = false;
+    pass.width = 0;
+    pass.pointers = this;
+    counting = true;
+    ::print_impl(pass, val);
+    drain(pass);
+    counting = false;
+  }
+
+  // The printing pass, followed by the pointees it queued
+  template <typename T>
+  void print(PrintContext& ctx, const T& val) {
+    ::print_impl(ctx, val);
+    drain(ctx);
+  }
+
+  // Prints the pointee of a followed pointer
+  template <typename T>
+  void follow_pointee(PrintContext& ctx, const T& val) {
+    if (hops == max_hops) return defer(ctx, val);
+    hops++;
+    follow(ctx, val);
+    hops--;
+  }
+
+  // Prints val, or its label if it was printed before
+  template <typename T>
+  void follow(PrintContext& ctx, const T& val) {
+    const void* type = &type_tag<T>;
+    Entry* entry = insert(&val, type);
+    if (counting) {
+      if (entry->count++ == 0) ::print_value(ctx, val);
+      return;
+    }
+    if (ctx.layout && ctx.layout->is_measuring()) {
+      // measures the object being printed, or what its layout would show;
+      // the path of the measurement guards against cycles
+      const bool measured = &val == current_obj && type == current_type;
+      if (entry->on_path || (entry->printed && !measured))
+        return print_label(ctx, '&', entry->id ? entry->id : ids + 1);
+      if (!measured && entry->count > 1) {
+        print_label(ctx, '#', ids + 1);
+        ctx.os << " ";
+      }
+      entry->on_path = true;
+      ::print_value(ctx, val);
+      insert(&val, type)->on_path = false;
+      return;
+    }
+    if (entry->printed) return print_label(ctx, '&', entry->id);
+    entry->printed = true;
+    if (entry->count > 1) {
+      entry->id = ++ids;
+      print_label(ctx, '#', entry->id);
+      ctx.os << " ";
+    }
+    const void* outer_obj = std::exchange(current_obj, &val);
+    const void* outer_type = std::exchange(current_type, type);
+    ::print_value(ctx, val);
+    current_obj = outer_obj;
+    current_type = outer_type;
+  }
+};
+
 template <typename T>
 void print_impl(PrintContext ctx, const T& val) {
+  if (ctx.follow_pointers && !ctx.pointers) {
+    PointerLabels pointers;
+    pointers.count(ctx, val);
+    ctx.pointers = &pointers;
+    return pointers.print(ctx, val);
+  }
+  if (ctx.width && !ctx.layout) {
+    PrintLayout layout;
+    ctx.layout = &layout;
+    return print_impl(ctx, val);
+  }
+  if constexpr (is_pointer_target_v<T>)
+    if (ctx.pointers) return ctx.pointers->follow(ctx, val);
+  print_value(ctx, val);
+}
+
+// print_impl() once the print call is set up
+template <typename T>
+void print_value(PrintContext ctx, const T& val) {
+  const size_t start = ctx.layout ? ctx.layout->mark() : 0;
   Printer<T>::print(ctx, val);
   if (ctx.memstat) print_memstat(ctx, val);
+  if (ctx.layout) ctx.layout->record(val, start);
+}
+
+// Helper to skip rendering into streams that drop everything
+inline bool is_sink_enabled(const std::ostream& os) {
+  return os.good() && os.rdbuf() != nullptr;
 }
 
 // Main print functions
 template <typename T>
-void print(std::ostream& os, const T& val) {
-  PrintContext ctx{os};
+void print(std::ostream& os, const T& val, const PrintOptions& opts = {}) {
+  if (!is_sink_enabled(os)) return;
+  PrintContext ctx{os, opts};
   print_impl(ctx, val);
 }
 
@@ -182,50 +613,38 @@ void printerr(const T& val) {
 }
 
 template <typename T>
-std::string stringify(const T& val) {
+std::string stringify(const T& val, const PrintOptions& opts = {}) {
   std::stringstream ss;
-  print(ss, val);
+  print(ss, val, opts);
   return ss.str();
 }
 
-// range print
-
-template <typename T, typename = void>
-struct is_range : std::false_type {};
-
+// Deferred print: captures a reference and renders only when inserted into
+// a stream that is enabled, e.g. `log(DEBUG) << lazy_print(state)` costs
+// nothing while the debug stream is in a failed state. Must not outlive val.
 template <typename T>
-struct is_range<T, std::void_t<decltype(std::begin(std::declval<T>())),
-                               decltype(std::end(std::declval<T>()))>>
-    : std::true_type {};
-
-template <typename T>
-struct is_range<T, std::enable_if_t<std::is_array_v<T>>> : std::true_type {};
-
-template <typename T>
-constexpr bool is_range_v = is_range<T>::value;
-
-// Helper to detect if type is a set-like container
-template <typename T, typename = void>
-struct has_keys : std::false_type {};
+struct LazyPrint {
+  const T& val;
+  PrintOptions opts;
+};
 
 template <typename T>
-struct has_keys<T, std::void_t<typename T::key_type, typename T::value_type>>
-    : std::true_type {};
+struct is_memstattable<LazyPrint<T>> : std::false_type {};
 
 template <typename T>
-constexpr bool has_keys_v = has_keys<T>::value;
-
-// Helper to detect if type is a map-like container
-template <typename T, typename = void>
-struct is_map_like : std::false_type {};
+LazyPrint<T> lazy_print(const T& val, const PrintOptions& opts = {}) {
+  return {val, opts};
+}
 
 template <typename T>
-struct is_map_like<T,
-                   std::void_t<typename T::key_type, typename T::mapped_type>>
-    : std::true_type {};
+std::ostream& operator<<(std::ostream& os, const LazyPrint<T>& lazy) {
+  if (!is_sink_enabled(os)) return os;
+  PrintContext ctx{os, lazy.opts};
+  print_impl(ctx, lazy.val);
+  return os;
+}
 
-template <typename T>
-constexpr bool is_map_like_v = is_map_like<T>::value;
+// range print
 
 template <typename T>
 struct is_small_type<T, std::enable_if_t<is_string_like_v<T>>>
@@ -243,34 +662,317 @@ static constexpr PunctuatorSet dynlist{"[", ", ", "]", "\n"};
 static constexpr PunctuatorSet statlist{"(", ", ", ")", "\n"};
 };  // namespace punct
 
+// Whether a composite value goes on one line: without a width when all its
+// elements are small, otherwise when its flat rendering fits
+template <typename T>
+bool layout_inline(const PrintContext& ctx, const T& val, bool is_small) {
+  if (!ctx.multiline) return true;
+  if (!ctx.layout) return is_small;
+  const size_t limit = ctx.line_width();
+  return ctx.layout->flat_width(ctx, val, limit) <= limit;
+}
+
+// Inline values print their elements flat, split ones indent them
+inline void apply_layout(PrintContext& ctx, PunctuatorSet& punct,
+                         bool is_inline) {
+  if (!is_inline) return void(ctx.depth++);
+  punct.split = "";
+  if (ctx.layout) ctx.multiline = false;
+}
+
+// numeric summary
+
+// Statistics of arithmetic values, NaNs excluded from min/max/mean
+template <typename T>
+struct NumericSummary {
+  using limits = std::numeric_limits<T>;
+  static constexpr T initial_min = limits::has_infinity ? limits::infinity()
+                                                        : limits::max();
+  static constexpr T initial_max = limits::has_infinity ? -limits::infinity()
+                                                        : limits::lowest();
+  // independent accumulators, so the contiguous loop vectorizes without
+  // reassociating floating point sums
+  static constexpr size_t lanes = 8;
+
+  size_t count = 0;
+  size_t nan = 0;
+  T min = initial_min;
+  T max = initial_max;
+  double sum = 0;
+
+  void add(T val) {
+    count++;
+    if (val != val) return void(nan++);
+    min = val < min ? val : min;
+    max = max < val ? val : max;
+    sum += double(val);
+  }
+
+  void add(const T* data, size_t size) {
+    T lane_min[lanes], lane_max[lanes];
+    double lane_sum[lanes] = {};
+    size_t lane_nan[lanes] = {};
+    std::fill(lane_min, lane_min + lanes, initial_min);
+    std::fill(lane_max, lane_max + lanes, initial_max);
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      for (size_t j = 0; j < lanes; ++j) {
+        const T val = data[i + j];
+        const bool is_nan = val != val;
+        lane_nan[j] += is_nan;
+        lane_sum[j] += is_nan ? 0.0 : double(val);
+        lane_min[j] = val < lane_min[j] ? val : lane_min[j];
+        lane_max[j] = lane_max[j] < val ? val : lane_max[j];
+      }
+    }
+    for (size_t j = 0; j < lanes; ++j) {
+      nan += lane_nan[j];
+      sum += lane_sum[j];
+      min = lane_min[j] < min ? lane_min[j] : min;
+      max = max < lane_max[j] ? lane_max[j] : max;
+    }
+    count += i;
+    for (; i < size; ++i) add(data[i]);
+  }
+
+  // values that are not NaN
+  size_t valid() const { return count - nan; }
+  double mean() const { return valid() ? sum / double(valid()) : 0.0; }
+};
+
+template <typename Range>
+auto summarize_range(const Range& range) {
+  using value_type = std::remove_cv_t<std::remove_reference_t<decltype(
+      *std::begin(range))>>;
+  NumericSummary<value_type> summary;
+  if constexpr (is_contiguous_range_v<Range>) {
+    summary.add(std::data(range), std::size(range));
+  } else {
+    for (const auto& val : range) summary.add(val);
+  }
+  return summary;
+}
+
+// [n=4000000 min=0 max=1 mean=0.5 nan=3 | 0.1, 0.7, ..., 0.2, 0.4]
+template <typename Range>
+void print_summary(PrintContext ctx, const Range& range, size_t size,
+                   PunctuatorSet punct) {
+  using value_type = std::remove_cv_t<std::remove_reference_t<decltype(
+      *std::begin(range))>>;
+  const auto summary = summarize_range(range);
+  ctx.os << punct.start << "n=" << size;
+  if (summary.valid()) {
+    ctx.os << " min=";
+    ::print_impl(ctx, summary.min);
+    ctx.os << " max=";
+    ::print_impl(ctx, summary.max);
+    ctx.os << " mean=";
+    ::print_impl(ctx, summary.mean());
+  }
+  if constexpr (std::is_floating_point_v<value_type>) {
+    ctx.os << " nan=";
+    ::print_impl(ctx, summary.nan);
+  }
+  ctx.os << " | ";
+  const size_t items = std::min(ctx.summary_items, size / 2);
+  auto it = std::begin(range);
+  for (size_t i = 0; i < items; ++i, ++it) {
+    ::print_impl(ctx, *it);
+    ctx.os << punct.sep;
+  }
+  ctx.os << "...";
+  std::advance(it, size - 2 * items);
+  for (size_t i = 0; i < items; ++i, ++it) {
+    ctx.os << punct.sep;
+    ::print_impl(ctx, *it);
+  }
+  ctx.os << punct.end;
+}
+
+// run-length collapsing
+
+// Element types whose runs are collapsed: with operator==, or compared
+// bytewise if trivially copyable. Standard containers, pairs, tuples and
+// optionals declare operator== for any element type, so they count only if
+// their elements do.
+template <typename T, typename = void>
+struct is_run_comparable
+    : std::bool_constant<is_equality_comparable_v<T> ||
+                         std::is_trivially_copyable_v<T>> {};
+
+template <typename T>
+struct is_run_comparable<
+    T, std::enable_if_t<is_range_v<T> && !is_string_like_v<T>>>
+    : std::bool_constant<
+          is_equality_comparable_v<T> &&
+          is_run_comparable<typename std::iterator_traits<decltype(std::begin(
+              std::declval<const T&>()))>::value_type>::value> {};
+
+template <typename A, typename B>
+struct is_run_comparable<std::pair<A, B>>
+    : std::bool_constant<is_run_comparable<A>::value &&
+                         is_run_comparable<B>::value &&
+                         is_equality_comparable_v<A> &&
+                         is_equality_comparable_v<B>> {};
+
+template <typename... Ts>
+struct is_run_comparable<std::tuple<Ts...>>
+    : std::bool_constant<((is_run_comparable<Ts>::value &&
+                           is_equality_comparable_v<Ts>)&&...)> {};
+
+template <typename T>
+struct is_run_comparable<std::optional<T>>
+    : std::bool_constant<is_run_comparable<T>::value &&
+                         is_equality_comparable_v<T>> {};
+
+template <typename T>
+constexpr bool is_run_comparable_v = is_run_comparable<T>::value;
+
+// Whether a and b print the same; floating point values compare their sign
+// too, so -0 and 0 stay apart and NaNs of one sign match
+template <typename T>
+bool same_value(const T& a, const T& b) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return std::signbit(a) == std::signbit(b) &&
+           (a == b || (a != a && b != b));
+  } else if constexpr (is_equality_comparable_v<T>) {
+    return a == b;
+  } else {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+  }
+}
+
+// Length of the run at the start of data. Whole blocks are compared by
+// their bits without early exit, so the loop vectorizes; the block with a
+// difference is rescanned with same_value.
+template <typename T>
+size_t equal_run(const T* data, size_t size) {
+  size_t i = 1;
+  if constexpr (sizeof(T) <= 8) {
+    using Bits = std::conditional_t<
+        sizeof(T) == 1, uint8_t,
+        std::conditional_t<sizeof(T) == 2, uint16_t,
+                           std::conditional_t<sizeof(T) == 4, uint32_t,
+                                              uint64_t>>>;
+    static constexpr size_t block = 64 / sizeof(T);
+    Bits first = 0;
+    std::memcpy(&first, data, sizeof(T));
+    for (; i + block <= size; i += block) {
+      Bits diff = 0;
+      for (size_t j = 0; j < block; ++j) {
+        Bits bits = 0;
+        std::memcpy(&bits, data + i + j, sizeof(T));
+        diff |= bits ^ first;
+      }
+      if (diff) break;
+    }
+  }
+  while (i < size && same_value(data[i], data[0])) i++;
+  return i;
+}
+
+// Number of elements from it on that are equal to *it
+template <typename Range, typename It>
+size_t equal_run(const Range& range, It it, It end) {
+  using value_type = typename std::iterator_traits<It>::value_type;
+  if constexpr (is_contiguous_range_v<Range> &&
+                std::is_arithmetic_v<value_type>) {
+    const size_t offset = size_t(std::distance(std::begin(range), it));
+    return equal_run(std::data(range) + offset, std::size(range) - offset);
+  } else {
+    size_t run = 1;
+    for (It next = std::next(it); next != end && same_value(*next, *it);
+         ++next)
+      run++;
+    return run;
+  }
+}
+
+// " ×4096"
+inline std::string_view run_suffix(size_t run, char (&buffer)[32]) {
+  static constexpr std::string_view times = " \xc3\x97";
+  std::memcpy(buffer, times.data(), times.size());
+  const auto end =
+      std::to_chars(buffer + times.size(), buffer + sizeof(buffer), run).ptr;
+  return {buffer, size_t(end - buffer)};
+}
+
+// An element of a range printer, "key: value" for maps
+template <typename T, typename It>
+void print_element(const PrintContext& ctx, const It& it) {
+  if constexpr (is_map_like_v<T>) {
+    ::print_impl(ctx, it->first);
+    ctx.os << ": ";
+    ::print_impl(ctx, it->second);
+  } else {
+    ::print_impl(ctx, *it);
+  }
+}
+
 // range printer
 template <typename T>
-struct Printer<T, std::enable_if_t<is_range_v<T> && !is_string_like_v<T>>> {
+struct Printer<T, std::enable_if_t<is_range_v<T> && !is_string_like_v<T> &&
+                                   !is_byte_range_v<T>>> {
   static void print(PrintContext ctx, const T& range) {
     using value_type =
         typename std::iterator_traits<decltype(std::begin(range))>::value_type;
-    static constexpr bool is_small = is_small_type_v<value_type>;
+    static constexpr bool is_small =
+        is_small_type_v<value_type> && !is_map_like_v<T>;
     PunctuatorSet punct = has_keys_v<T> ? punct::keylist : punct::dynlist;
-    punct.split = is_small ? "" : punct.split;
-    if constexpr (is_map_like_v<T>) punct.split = "\n";
-    if (!ctx.multiline) punct.split = "";
+    if constexpr (std::is_arithmetic_v<value_type> &&
+                  !std::is_same_v<value_type, bool>) {
+      if (ctx.summarize) {
+        const auto size = std::distance(std::begin(range), std::end(range));
+        if (size_t(size) > ctx.summarize)
+          return print_summary(ctx, range, size_t(size), punct);
+      }
+    }
+    const bool is_inline = layout_inline(ctx, range, is_small);
+    // small elements that do not fit on one line are wrapped at the width
+    const bool wrap = !is_inline && ctx.layout && is_small;
+    apply_layout(ctx, punct, is_inline);
 
     ctx.os << punct.start;
     {
       const indentos indent{ctx.os, false};
+      const size_t limit = ctx.line_width();
+      size_t column = 0;
       auto it = std::begin(range);
       auto end = std::end(range);
       bool first = true;
-      for (; it != end; ++it) {
+      size_t plain = 0;  // elements of a short run, printed one by one
+      // a failed stream ends measuring early
+      for (; it != end && ctx.os.good(); ++it) {
+        size_t run = 1;
+        if constexpr (is_run_comparable_v<value_type> && !is_map_like_v<T>) {
+          if (plain) {
+            plain--;
+          } else if (ctx.collapse) {
+            run = equal_run(range, it, end);
+            if (run < ctx.collapse) {
+              plain = run - 1;
+              run = 1;
+            }
+          }
+        }
+        char buffer[32];
+        const std::string_view suffix =
+            run > 1 ? run_suffix(run, buffer) : std::string_view{};
         if (!first) ctx.os << punct.sep;
-        ctx.os << punct.split;
-        if constexpr (is_map_like_v<T>) {
-          ::print_impl(ctx, it->first);
-          ctx.os << ": ";
-          ::print_impl(ctx, it->second);
+        if (wrap) {
+          const size_t size =
+              ctx.layout->flat_width(ctx, *it, limit) + suffix.size();
+          if (first || column + size > limit) {
+            ctx.os << punct.split;
+            column = 0;
+          }
+          column += size + std::strlen(punct.sep);
         } else {
-          ::print_impl(ctx, *it);
+          ctx.os << punct.split;
         }
+        print_element<T>(ctx, it);
+        ctx.os << suffix;
+        std::advance(it, run - 1);
         first = false;
       }
     }
@@ -278,14 +980,187 @@ struct Printer<T, std::enable_if_t<is_range_v<T> && !is_string_like_v<T>>> {
   }
 };
 
+// byte printers
+
+// single bytes print as numbers rather than raw characters
+template <typename T>
+struct Printer<T, std::enable_if_t<std::is_same_v<T, unsigned char> ||
+                                   std::is_same_v<T, signed char>>> {
+  static void print(PrintContext ctx, const T& val) {
+    if (ctx.colors) ctx.os << Theme::color_number;
+    ctx.os << int(val);
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  }
+};
+
+// "0a" for every byte value
+inline constexpr auto hex_pairs = [] {
+  constexpr char digits[] = "0123456789abcdef";
+  std::array<char, 512> table{};
+  for (size_t i = 0; i < 256; ++i) {
+    table[2 * i] = digits[i >> 4];
+    table[2 * i + 1] = digits[i & 15];
+  }
+  return table;
+}();
+
+template <>
+struct Printer<std::byte> {
+  static void print(PrintContext ctx, const std::byte& val) {
+    if (ctx.colors) ctx.os << Theme::color_number;
+    ctx.os << "0x";
+    ctx.os.write(&hex_pairs[2 * size_t(val)], 2);
+    if (ctx.colors) ctx.os << Theme::color_reset;
+  }
+};
+
+// Raw memory for the blob printer, e.g. print(os, bytes_of(&header, 64))
+struct ByteView {
+  const unsigned char* ptr;
+  size_t count;
+
+  const unsigned char* data() const { return ptr; }
+  size_t size() const { return count; }
+};
+
+inline ByteView bytes_of(const void* data, size_t size) {
+  return {static_cast<const unsigned char*>(data), size};
+}
+
+template <>
+struct is_memstattable<ByteView> : std::false_type {};
+
+// Blob printer for byte ranges: a hexdump with offsets and an ASCII column,
+// or a single "[de ad be ef]" line when inline. Every line is built in a
+// local buffer and written at once.
+class BlobPrinter {
+  static constexpr size_t row_bytes = 16;
+  // longest row: offset, hex and ascii columns with their colors
+  static constexpr size_t row_size = 16 + 2 + row_bytes * 3 + 1 + row_bytes +
+                                     3 + 6 * ansi::Ansi::max_size;
+
+  PrintContext& ctx;
+  const unsigned char* bytes;
+  size_t size;
+  size_t shown;
+  std::string_view color_offset, color_hex, color_ascii, color_reset;
+
+  static char* append(char* out, std::string_view str) {
+    std::memcpy(out, str.data(), str.size());
+    return out + str.size();
+  }
+
+  static char* append_hex(char* out, unsigned char byte) {
+    std::memcpy(out, &hex_pairs[2 * byte], 2);
+    return out + 2;
+  }
+
+  void print_more() {
+    if (shown < size) ctx.os << "... " << size - shown << " more bytes";
+  }
+
+ public:
+  BlobPrinter(PrintContext& ctx, const unsigned char* bytes, size_t size)
+      : ctx(ctx),
+        bytes(bytes),
+        size(size),
+        shown(ctx.blob_limit ? std::min(size, ctx.blob_limit) : size) {
+    const auto mode =
+        ctx.colors ? ansi::color_mode(ctx.os) : ansi::ColorMode::none;
+    color_offset = Theme::str(Theme::color_constant, mode);
+    color_hex = Theme::str(Theme::color_number, mode);
+    color_ascii = Theme::str(Theme::color_string, mode);
+    color_reset = Theme::str(Theme::color_reset, mode);
+  }
+
+  // [48 65 6c 6c 6f]
+  void print_inline() {
+    char line[row_size];
+    ctx.os << "[";
+    // a failed stream ends measuring early
+    for (size_t row = 0; row < shown && ctx.os.good(); row += row_bytes) {
+      const size_t end = std::min(shown, row + row_bytes);
+      char* out = append(line, color_hex);
+      for (size_t i = row; i < end; ++i) {
+        if (i) *out++ = ' ';
+        out = append_hex(out, bytes[i]);
+      }
+      out = append(out, color_reset);
+      ctx.os.write(line, out - line);
+    }
+    if (shown < size) ctx.os << (shown ? " " : "");
+    print_more();
+    ctx.os << "]";
+  }
+
+  // 00000000  48 65 6c 6c 6f 20 77 6f  72 6c 64 0a              |Hello world.|
+  void print_rows() {
+    const int offset_digits = size > 0xffffffff ? 16 : 8;
+    char line[row_size];
+    ctx.os << "[";
+    {
+      const indentos indent{ctx.os, false};
+      for (size_t row = 0; row < shown && ctx.os.good(); row += row_bytes) {
+        const size_t count = std::min(row_bytes, shown - row);
+        char* out = line;
+        *out++ = '\n';
+        out = append(out, color_offset);
+        for (int shift = 4 * (offset_digits - 1); shift >= 0; shift -= 4)
+          *out++ = hex_pairs[2 * ((row >> shift) & 15) + 1];
+        out = append(out, color_reset);
+        *out++ = ' ';
+        out = append(out, color_hex);
+        for (size_t i = 0; i < row_bytes; ++i) {
+          if (i % 8 == 0) *out++ = ' ';
+          if (i < count) {
+            out = append_hex(out, bytes[row + i]);
+          } else {
+            *out++ = ' ';
+            *out++ = ' ';
+          }
+          *out++ = ' ';
+        }
+        out = append(out, color_reset);
+        *out++ = ' ';
+        *out++ = '|';
+        out = append(out, color_ascii);
+        for (size_t i = 0; i < count; ++i) {
+          const unsigned char byte = bytes[row + i];
+          *out++ = byte >= 0x20 && byte < 0x7f ? char(byte) : '.';
+        }
+        out = append(out, color_reset);
+        *out++ = '|';
+        ctx.os.write(line, out - line);
+      }
+      if (shown < size) ctx.os << "\n";
+      print_more();
+    }
+    ctx.os << "\n]";
+  }
+};
+
+template <typename T>
+struct Printer<T,
+               std::enable_if_t<is_byte_range_v<T> && !is_string_like_v<T>>> {
+  static void print(PrintContext ctx, const T& blob) {
+    BlobPrinter printer{
+        ctx, reinterpret_cast<const unsigned char*>(std::data(blob)),
+        std::size(blob)};
+    // up to one hexdump row stays inline without a width
+    if (layout_inline(ctx, blob, std::size(blob) <= 16))
+      printer.print_inline();
+    else
+      printer.print_rows();
+  }
+};
+
 // pair printer
 template <typename T1, typename T2>
 struct Printer<std::pair<T1, T2>> {
   static void print(PrintContext ctx, const std::pair<T1, T2>& pair) {
     const bool is_small = is_small_type_v<T1> && is_small_type_v<T2>;
     PunctuatorSet punct = punct::statlist;
-    punct.split = is_small ? "" : punct.split;
-    if (!ctx.multiline) punct.split = "";
+    apply_layout(ctx, punct, layout_inline(ctx, pair, is_small));
 
     ctx.os << punct.start;
     {
@@ -305,14 +1180,13 @@ template <typename... Types>
 void print_tuple(PrintContext ctx, const std::tuple<Types...>& t,
                  PunctuatorSet punct) {
   const bool is_small = (is_small_type<Types>::value && ...);
-  punct.split = is_small ? "" : punct.split;
-  if (!ctx.multiline) punct.split = "";
+  apply_layout(ctx, punct, layout_inline(ctx, t, is_small));
 
   ctx.os << punct.start;
   {
     const indentos indent{ctx.os, false};
     std::apply(
-        [&](auto... args) {
+        [&](const auto&... args) {
           bool first = true;
           ((ctx.os << (first ? "" : punct.sep) << punct.split, first = false,
             ::print_impl(ctx, args)),
@@ -341,18 +1215,121 @@ struct Printer<std::optional<T>> {
   }
 };
 
+// pointer printers
+
+template <typename T>
+struct Printer<T, std::enable_if_t<is_followed_pointer_v<T>>> {
+  static void print(PrintContext ctx, const T& ptr) {
+    if (!ctx.pointers) return print_default(ctx, ptr);
+    if (!ptr) {
+      if (ctx.colors) ctx.os << Theme::color_constant;
+      ctx.os << "nullptr";
+      if (ctx.colors) ctx.os << Theme::color_reset;
+      return;
+    }
+    ctx.pointers->follow_pointee(ctx, *ptr);
+  }
+};
+
 // struct printer
 
+// Literal joined at compile time, so fixed struct decorations (names,
+// colors, punctuation) cost a single write
+template <size_t N>
+struct FusedLiteral {
+  char data[N]{};
+  size_t size = 0;
+
+  constexpr void append(std::string_view str) {
+    for (char ch : str) data[size++] = ch;
+  }
+  constexpr std::string_view view() const { return {data, size}; }
+};
+
+// ".name= " and the type name header, for every ansi::ColorMode
+template <size_t N>
+struct FieldLiterals {
+  static constexpr size_t capacity = N + 2 * ansi::Ansi::max_size + 4;
+  FusedLiteral<capacity> modes[ansi::ncolor_modes];
+
+  constexpr FieldLiterals(const char (&name)[N]) {
+    for (size_t i = 0; i < ansi::ncolor_modes; ++i) {
+      const auto mode = ansi::ColorMode(i);
+      modes[i].append(".");
+      modes[i].append(Theme::str(Theme::color_variable, mode));
+      modes[i].append(name);
+      modes[i].append(Theme::str(Theme::color_reset, mode));
+      modes[i].append("= ");
+    }
+  }
+};
+
+template <size_t N>
+struct TypeLiterals {
+  static constexpr size_t capacity = N + 2 * ansi::Ansi::max_size;
+  FusedLiteral<capacity> modes[ansi::ncolor_modes];
+
+  constexpr TypeLiterals(const char (&name)[N]) {
+    for (size_t i = 0; i < ansi::ncolor_modes; ++i) {
+      const auto mode = ansi::ColorMode(i);
+      modes[i].append(Theme::str(Theme::color_typename, mode));
+      modes[i].append(name);
+      modes[i].append(Theme::str(Theme::color_reset, mode));
+    }
+  }
+};
+
+// string_views of every mode of a FieldLiterals/TypeLiterals
+struct FusedViews {
+  std::string_view modes[ansi::ncolor_modes];
+
+  FusedViews() = default;
+  template <typename Literals>
+  constexpr FusedViews(const Literals& literals) {
+    for (size_t i = 0; i < ansi::ncolor_modes; ++i)
+      modes[i] = literals.modes[i].view();
+  }
+  bool empty() const { return modes[0].empty(); }
+};
+
+// Reference to a constant-initialized static, built from a string literal
+#define FUSED_LITERALS(Literals, str)              \
+  []() -> const auto& {                            \
+    static constexpr Literals fused_literals{str}; \
+    return fused_literals;                         \
+  }()
+
+inline void write_fused(PrintContext& ctx, const FusedViews& fused) {
+  const auto mode =
+      ctx.colors ? ansi::color_mode(ctx.os) : ansi::ColorMode::none;
+  const std::string_view str = fused.modes[size_t(mode)];
+  ctx.os.write(str.data(), str.size());
+}
+
 template <typename FieldT>
 struct FieldInfo {
   const char* name;
   const FieldT& value;
+  FusedViews fused;  // ".name= " per color mode, if precomputed
+
   FieldInfo(const char* name, const FieldT& value) : name(name), value(value) {}
+  template <size_t N>
+  FieldInfo(const char* name, const FieldT& value,
+            const FieldLiterals<N>& literals)
+      : name(name),
+        value(value),
+        fused(literals) {}
 };
 
 template <typename FieldT>
 struct is_small_type<FieldInfo<FieldT>> : std::false_type {};
 
+// field infos are temporaries, so are struct infos and their field tuples
+template <typename FieldT>
+struct is_layout_cached<FieldInfo<FieldT>> : std::false_type {};
+template <typename... FieldTs>
+struct is_layout_cached<std::tuple<FieldInfo<FieldTs>...>> : std::false_type {};
+
 template <typename T>
 struct is_memstattable<FieldInfo<T>> : std::false_type {};
 
@@ -360,22 +1337,35 @@ template <typename... FieldTs>
 struct StructInfo {
   const char* tname;
   std::tuple<FieldInfo<FieldTs>...> field_infos;
+  FusedViews fused;  // type name per color mode, if precomputed
 
   constexpr StructInfo(const char* tname, FieldInfo<FieldTs>... fields)
       : tname(tname), field_infos(std::make_tuple(fields...)) {}
+  template <size_t N>
+  constexpr StructInfo(const TypeLiterals<N>& literals,
+                       FieldInfo<FieldTs>... fields)
+      : tname(literals.modes[0].data),
+        field_infos(std::make_tuple(fields...)),
+        fused(literals) {}
 };
 
 template <typename... Ts>
 struct is_memstattable<StructInfo<Ts...>> : std::false_type {};
+template <typename... Ts>
+struct is_layout_cached<StructInfo<Ts...>> : std::false_type {};
 
 template <typename T>
 struct Printer<FieldInfo<T>> {
   static void print(PrintContext ctx, const FieldInfo<T>& field_info) {
-    ctx.os << ".";
-    if (ctx.colors) ctx.os << Theme::color_variable;
-    ctx.os << field_info.name;
-    if (ctx.colors) ctx.os << Theme::color_reset;
-    ctx.os << "= ";
+    if (!field_info.fused.empty()) {
+      write_fused(ctx, field_info.fused);
+    } else {
+      ctx.os << ".";
+      if (ctx.colors) ctx.os << Theme::color_variable;
+      ctx.os << field_info.name;
+      if (ctx.colors) ctx.os << Theme::color_reset;
+      ctx.os << "= ";
+    }
     ::print_impl(ctx, field_info.value);
   }
 };
@@ -384,35 +1374,41 @@ template <typename... FieldTs>
 struct Printer<StructInfo<FieldTs...>> {
   static void print(PrintContext ctx,
                     const StructInfo<FieldTs...>& struct_info) {
-    if (ctx.colors) ctx.os << Theme::color_typename;
-    ctx.os << struct_info.tname;
-    if (ctx.colors) ctx.os << Theme::color_reset;
+    if (!struct_info.fused.empty()) {
+      write_fused(ctx, struct_info.fused);
+    } else {
+      if (ctx.colors) ctx.os << Theme::color_typename;
+      ctx.os << struct_info.tname;
+      if (ctx.colors) ctx.os << Theme::color_reset;
+    }
     print_tuple(ctx, struct_info.field_infos, punct::keylist);
   }
 };
 
 // convenience macro
 
-#define FIELD_INFO(field) \
-  FieldInfo {             \
-#field, field         \
+#define FIELD_INFO(field)                            \
+  FieldInfo {                                        \
+#field, field, FUSED_LITERALS(FieldLiterals, #field) \
   }
-#define INLINE_PRINT(Type, fields...)                                         \
-  void print(PrintContext ctx) const {                                        \
-    const auto info = StructInfo(#Type, PP_FOREACH_LIST(FIELD_INFO, fields)); \
-    ::print_impl(ctx, info);                                                  \
+#define INLINE_PRINT(Type, fields...)                                  \
+  void print(PrintContext ctx) const {                                 \
+    const auto info = StructInfo(FUSED_LITERALS(TypeLiterals, #Type),  \
+                                 PP_FOREACH_LIST(FIELD_INFO, fields)); \
+    ::print_impl(ctx, info);                                           \
   }
 
-#define OBJ_FIELD_INFO(obj, field) \
-  FieldInfo {                      \
-#field, obj.field              \
+#define OBJ_FIELD_INFO(obj, field)                       \
+  FieldInfo {                                            \
+#field, obj.field, FUSED_LITERALS(FieldLiterals, #field) \
   }
-#define PRINT_STRUCT(Type, fields...)                                    \
-  template <>                                                            \
-  struct Printer<Type> {                                                 \
-    static void print(PrintContext ctx, const Type& obj) {               \
-      const auto info = StructInfo(                                      \
-          #Type, PP_FOREACH_LIST(PP_BIND(OBJ_FIELD_INFO, obj), fields)); \
-      ::print_impl(ctx, info);                                           \
-    }                                                                    \
+#define PRINT_STRUCT(Type, fields...)                                        \
+  template <>                                                                \
+  struct Printer<Type> {                                                     \
+    static void print(PrintContext ctx, const Type& obj) {                   \
+      const auto info =                                                      \
+          StructInfo(FUSED_LITERALS(TypeLiterals, #Type),                    \
+                     PP_FOREACH_LIST(PP_BIND(OBJ_FIELD_INFO, obj), fields)); \
+      ::print_impl(ctx, info);                                               \
+    }                                                                        \
   };
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ansi.h"
+#include "pprint.h"
+
+// Off-screen frame for live terminal views. Text, including SGR colors as
+// produced by stringify, is written into a grid of cells; flush() sends only
+// the cells that changed since the previous frame, with the shortest cursor
+// moves and style changes, in a single write.
+
+// Graphic rendition of a cell. Colors are kind | value: an index for
+// `indexed` (0-15 basic, up to 255 extended), 0xRRGGBB for `rgb`.
+// Attributes are a bitmask of the SGR codes 1-9.
+struct ScreenStyle {
+  static constexpr uint32_t deflt = 0;
+  static constexpr uint32_t indexed = 1u << 24;
+  static constexpr uint32_t rgb = 2u << 24;
+
+  uint32_t fg = deflt;
+  uint32_t bg = deflt;
+  uint16_t attrs = 0;
+
+  bool operator==(const ScreenStyle& other) const {
+    return fg == other.fg && bg == other.bg && attrs == other.attrs;
+  }
+  bool operator!=(const ScreenStyle& other) const { return !(*this == other); }
+
+  // Applies the parameters of one SGR sequence
+  void apply(const int* params, size_t n) {
+    if (n == 0) *this = {};
+    for (size_t i = 0; i < n; ++i) {
+      const int p = params[i];
+      if (p == 0) {
+        *this = {};
+      } else if (p >= 1 && p <= 9) {
+        attrs |= uint16_t(1 << p);
+      } else if (p == 22) {
+        attrs &= uint16_t(~(1 << 1 | 1 << 2));
+      } else if (p >= 23 && p <= 29) {
+        attrs &= uint16_t(~(1 << (p - 20)));
+      } else if (p >= 30 && p <= 37) {
+        fg = indexed | uint32_t(p - 30);
+      } else if (p >= 40 && p <= 47) {
+        bg = indexed | uint32_t(p - 40);
+      } else if (p >= 90 && p <= 97) {
+        fg = indexed | uint32_t(p - 90 + 8);
+      } else if (p >= 100 && p <= 107) {
+        bg = indexed | uint32_t(p - 100 + 8);
+      } else if (p == 39) {
+        fg = deflt;
+      } else if (p == 49) {
+        bg = deflt;
+      } else if (p == 38 || p == 48) {
+        uint32_t& color = p == 38 ? fg : bg;
+        if (i + 2 < n && params[i + 1] == 5) {
+          color = indexed | uint32_t(params[i + 2] & 0xff);
+          i += 2;
+        } else if (i + 4 < n && params[i + 1] == 2) {
+          color = rgb | uint32_t((params[i + 2] & 0xff) << 16 |
+                                 (params[i + 3] & 0xff) << 8 |
+                                 (params[i + 4] & 0xff));
+          i += 4;
+        }
+      }
+    }
+  }
+};
+
+// A wide character takes its cell and the next one, whose len is 0
+struct ScreenCell {
+  char ch[4] = {' '};  // one UTF-8 encoded character
+  uint8_t len = 1;     // 0 for the right half of a wide character
+  ScreenStyle style;
+
+  bool operator==(const ScreenCell& other) const {
+    return len == other.len && std::equal(ch, ch + len, other.ch) &&
+           style == other.style;
+  }
+  bool operator!=(const ScreenCell& other) const { return !(*this == other); }
+};
+
+// Region of a screen, in 0-based cells
+struct Rect {
+  int y, x, h, w;
+};
+
+class Screen {
+  int rows, cols;
+  std::vector<ScreenCell> back;   // frame being drawn
+  std::vector<ScreenCell> front;  // what the terminal shows
+  bool full = true;               // terminal contents unknown
+  // terminal cursor (-1 if unknown) and style after the last output
+  int cursor_y = -1, cursor_x = -1;
+  ScreenStyle pen;
+  ansi::ColorMode mode = ansi::ColorMode::truecolor;
+  std::string out;
+
+  void emit(const ansi::Ansi& a) {
+    char buf[ansi::Ansi::max_size];
+    out.append(buf, a.format(buf));
+  }
+
+  static size_t length(const ansi::Ansi& a) {
+    char buf[ansi::Ansi::max_size];
+    return a.format(buf);
+  }
+
+  static ansi::Ansi color_sgr(uint32_t color, int base) {
+    const uint32_t value = color & 0xffffff;
+    if ((color & ~0xffffffu) == ScreenStyle::rgb)
+      return ansi::SGR{base + ansi::color::set, 2, int(value >> 16),
+                       int(value >> 8 & 0xff), int(value & 0xff)};
+    if ((color & ~0xffffffu) != ScreenStyle::indexed)
+      return ansi::SGR{base + ansi::color::deflt};
+    if (value < 8) return ansi::SGR{base + int(value)};
+    if (value < 16) return ansi::SGR{base + 60 + int(value) - 8};
+    return ansi::SGR{base + ansi::color::set, 5, int(value)};
+  }
+
+  // Appends the parameters of a sequence to a combined SGR
+  void append_sgr(const ansi::Ansi& a, bool& first) {
+    for (int i = 0; i < a.nargs; ++i) {
+      out += first ? "" : ";";
+      out += std::to_string(a.args[i]);
+      first = false;
+    }
+  }
+
+  void set_style(const ScreenStyle& style) {
+    if (style == pen) return;
+    if (mode == ansi::ColorMode::none) return void(pen = style);
+    out += "\e[";
+    bool first = true;
+    // attributes can only be cleared together
+    if (pen.attrs & ~style.attrs) {
+      out += "0";
+      first = false;
+      pen = {};
+    }
+    for (int code = 1; code <= 9; ++code) {
+      if ((style.attrs & ~pen.attrs) & (1 << code)) {
+        out += first ? "" : ";";
+        out += char('0' + code);
+        first = false;
+      }
+    }
+    if (style.fg != pen.fg)
+      append_sgr(ansi::downgrade(color_sgr(style.fg, ansi::fg::base), mode),
+                 first);
+    if (style.bg != pen.bg)
+      append_sgr(ansi::downgrade(color_sgr(style.bg, ansi::bg::base), mode),
+                 first);
+    out += "m";
+    pen = style;
+  }
+
+  // Cheapest of an absolute move, a column move, a relative move, a line
+  // feed and rewriting the unchanged cells in between
+  void move_to(int y, int x) {
+    if (y == cursor_y && x == cursor_x) return;
+    size_t best = length(ansi::move(y + 1, x + 1));
+    int how = 0;
+    if (y == cursor_y) {
+      const auto rel = x > cursor_x ? ansi::forward(x - cursor_x)
+                                    : ansi::back(cursor_x - x);
+      if (length(rel) < best) best = length(rel), how = 1;
+      if (length(ansi::setx(x + 1)) < best)
+        best = length(ansi::setx(x + 1)), how = 2;
+      // not from or up to the middle of a wide character
+      if (x > cursor_x && size_t(x - cursor_x) < best &&
+          front[index(y, cursor_x)].len && front[index(y, x)].len) {
+        bool same_style = true;
+        for (int i = cursor_x; i < x && same_style; ++i)
+          same_style = front[index(y, i)].style == pen;
+        if (same_style) how = 3;
+      }
+    } else if (cursor_y >= 0 && y == cursor_y + 1 && x == 0 && best > 2) {
+      how = 4;
+    }
+    switch (how) {
+      case 0: emit(ansi::move(y + 1, x + 1)); break;
+      case 1:
+        emit(x > cursor_x ? ansi::forward(x - cursor_x)
+                          : ansi::back(cursor_x - x));
+        break;
+      case 2: emit(ansi::setx(x + 1)); break;
+      case 3:
+        for (int i = cursor_x; i < x; ++i) {
+          const ScreenCell& cell = front[index(y, i)];
+          out.append(cell.ch, cell.len);
+        }
+        break;
+      case 4: out += "\r\n"; break;
+    }
+    cursor_y = y;
+    cursor_x = x;
+  }
+
+  size_t index(int y, int x) const { return size_t(y) * cols + x; }
+
+  // Blanks the other half of a wide character covering y, x
+  void split(int y, int x) {
+    ScreenCell* other = nullptr;
+    if (back[index(y, x)].len == 0)
+      other = &back[index(y, x - 1)];
+    else if (x + 1 < cols && back[index(y, x + 1)].len == 0)
+      other = &back[index(y, x + 1)];
+    if (!other) return;
+    ScreenCell blank;
+    blank.style = other->style;
+    *other = blank;
+  }
+
+ public:
+  Screen(int rows, int cols)
+      : rows(rows), cols(cols), back(size_t(rows) * cols), front(back) {}
+
+  int height() const { return rows; }
+  int width() const { return cols; }
+
+  void resize(int rows, int cols) {
+    this->rows = rows;
+    this->cols = cols;
+    back.assign(size_t(rows) * cols, {});
+    front = back;
+    invalidate();
+  }
+
+  // Redraws everything on the next flush, e.g. after other output
+  void invalidate() { full = true; }
+
+  // Starts a new frame
+  void clear() { std::fill(back.begin(), back.end(), ScreenCell{}); }
+
+  ScreenCell& at(int y, int x) { return back[index(y, x)]; }
+
+  // Writes text into rect, clipped; '\n' continues on the next row of rect.
+  // SGR sequences set the style of the following cells, other escape
+  // sequences, control and zero width characters are dropped. East Asian
+  // wide characters take two cells, or a blank one at the right edge.
+  void write(Rect rect, std::string_view text) {
+    rect.h = std::min(rect.h, rows - rect.y);
+    rect.w = std::min(rect.w, cols - rect.x);
+    if (rect.y < 0 || rect.x < 0 || rect.h <= 0 || rect.w <= 0) return;
+    ScreenStyle style;
+    int y = 0, x = 0;
+    for (size_t i = 0; i < text.size() && y < rect.h;) {
+      const unsigned char ch = text[i];
+      if (ch == '\e') {
+        if (i + 1 < text.size() && text[i + 1] == '[') {
+          int params[16];
+          size_t n = 0;
+          int value = 0;
+          bool has_value = false;
+          for (i += 2; i < text.size(); ++i) {
+            const char c = text[i];
+            if (c >= '0' && c <= '9') {
+              value = value * 10 + (c - '0');
+              has_value = true;
+            } else if (c == ';') {
+              if (n < 16) params[n++] = value;
+              value = 0;
+              has_value = false;
+            } else {
+              if (has_value && n < 16) params[n++] = value;
+              if (c == 'm') style.apply(params, n);
+              if (c >= 0x40 && c <= 0x7e) break;
+            }
+          }
+          i++;
+        } else {
+          i += 2;
+        }
+        continue;
+      }
+      if (ch == '\n') {
+        y++;
+        x = 0;
+        i++;
+        continue;
+      }
+      const char* next = text.data() + i;
+      const char32_t cp =
+          ansi::unicode::decode(next, text.data() + text.size());
+      const int width = ansi::unicode::width(cp);
+      const size_t len = size_t(next - text.data()) - i;
+      if (width && x < rect.w) {
+        const int cy = rect.y + y, cx = rect.x + x;
+        const bool wide = width == 2 && x + 1 < rect.w;
+        split(cy, cx);
+        if (wide) split(cy, cx + 1);
+        ScreenCell& cell = back[index(cy, cx)];
+        cell = {};
+        if (width == 1 || wide) {
+          std::copy(text.data() + i, next, cell.ch);
+          cell.len = uint8_t(len);
+        }
+        cell.style = style;
+        if (wide) {
+          ScreenCell& right = back[index(cy, cx + 1)];
+          right.len = 0;
+          right.style = style;
+        }
+      }
+      x += width;
+      i += len;
+    }
+  }
+
+  void write(int y, int x, std::string_view text) {
+    write({y, x, rows - y, cols - x}, text);
+  }
+
+  // Renders val as print() would, wrapped to the width of rect
+  template <typename T>
+  void show(Rect rect, const T& val, PrintOptions opts = {}) {
+    std::ostringstream ss;
+    if (!opts.width) opts.width = size_t(std::max(rect.w, 1));
+    ::print(ss, val, opts);
+    write(rect, ss.str());
+  }
+
+  // Sends the changes since the last flush to os, downgrading colors to
+  // what it supports
+  void flush(std::ostream& os) {
+    mode = ansi::color_mode(os);
+    out.clear();
+    if (full) {
+      emit(ansi::reset);
+      emit(ansi::clear());
+      emit(ansi::move(1, 1));
+      std::fill(front.begin(), front.end(), ScreenCell{});
+      cursor_y = cursor_x = 0;
+      pen = {};
+      full = false;
+    }
+    for (int y = 0; y < rows; ++y) {
+      for (int x = 0; x < cols; ++x) {
+        const ScreenCell& cell = back[index(y, x)];
+        // right halves are drawn with their left half
+        if (cell.len == 0 || cell == front[index(y, x)]) continue;
+        move_to(y, x);
+        set_style(cell.style);
+        out.append(cell.ch, cell.len);
+        front[index(y, x)] = cell;
+        int width = 1;
+        if (x + 1 < cols && back[index(y, x + 1)].len == 0) {
+          front[index(y, x + 1)] = back[index(y, x + 1)];
+          width = 2;
+        }
+        // the cursor stays on the last column until the next character
+        cursor_x = x + width < cols ? x + width : -1;
+        if (cursor_x < 0) cursor_y = -1;
+      }
+    }
+    if (pen != ScreenStyle{}) set_style({});
+    os.write(out.data(), out.size());
+    os.flush();
+  }
+
+  // bytes sent by the last flush
+  size_t flushed() const { return out.size(); }
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <locale>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+
+#include "ansi.h"
+#include "pprint.h"
+
+// Printing from signal handlers, e.g. dumping state on a crash.
+//
+// A SignalPrinter is built up front, outside the handler: it owns the
+// stream, locale and formatting caches that print() needs, so rendering
+// through the regular Printer dispatch into the caller's buffer does not
+// allocate, lock or throw. Output that does not fit is cut at a character
+// boundary and marked with "...". The result is sent with write(2).
+//
+// Covered: numbers, strings, ranges, pairs, tuples, optionals and
+// INLINE_PRINT / PRINT_STRUCT types. memstat, width layouts and pointer
+// following are disabled, unprintable types show their mangled name. User
+// operator<< overloads are only as safe as their own code. A printer must
+// not be used by two handlers at once.
+
+// Output buffer over fixed memory; writes that do not fit are cut and the
+// buffer stays full
+class fixedbuf : public std::streambuf {
+  bool cut = false;
+
+ protected:
+  virtual int overflow(int ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+      return traits_type::not_eof(ch);
+    cut = true;
+    return traits_type::eof();
+  }
+
+  virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+    const size_t size = std::min(size_t(n), size_t(epptr() - pptr()));
+    std::memcpy(pptr(), s, size);
+    pbump(int(size));
+    if (size < size_t(n)) cut = true;
+    return std::streamsize(size);
+  }
+
+ public:
+  void reset(char* data, size_t size) {
+    setp(data, data + size);
+    cut = false;
+  }
+  size_t size() const { return size_t(pptr() - pbase()); }
+  bool overflowed() const { return cut; }
+};
+
+// Floating point output without printf, which may allocate for large
+// exponents. Same format as the default %g, the last digit may differ.
+class safe_num_put : public std::num_put<char> {
+ protected:
+  static char* put_digits(char* out, unsigned long long val, int count) {
+    for (int i = count - 1; i >= 0; --i, val /= 10)
+      out[i] = char('0' + val % 10);
+    return out + count;
+  }
+
+  // digits of |val| rounded to precision significant digits; returns the
+  // decimal exponent of the first digit
+  static int round_digits(double val, int precision, unsigned long long& m) {
+    int exp = int(std::floor(std::log10(val)));
+    unsigned long long low = 1;
+    for (int i = 1; i < precision; ++i) low *= 10;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+      // in extended precision, so exact halfway cases stay exact
+      const int shift = precision - 1 - exp;
+      const long double scaled =
+          (long double)val * std::pow(10.0L, (long double)shift);
+      m = (unsigned long long)std::nearbyint(scaled);  // ties to even
+      if (m >= low * 10) {
+        exp++;
+      } else if (m < low) {
+        exp--;
+      } else {
+        break;
+      }
+    }
+    if (m >= low * 10) m = low;
+    return exp;
+  }
+
+  virtual iter_type do_put(iter_type out, std::ios_base& str, char,
+                           double val) const {
+    char buf[64];
+    char* end = buf;
+    if (std::signbit(val)) *end++ = '-';
+    if (std::isnan(val)) {
+      end = std::copy_n("nan", 3, end);
+    } else if (std::isinf(val)) {
+      end = std::copy_n("inf", 3, end);
+    } else if (val == 0) {
+      *end++ = '0';
+    } else {
+      const int precision =
+          std::clamp(int(str.precision() ? str.precision() : 1), 1, 17);
+      unsigned long long m;
+      const int exp = round_digits(std::fabs(val), precision, m);
+      char digits[17];
+      put_digits(digits, m, precision);
+      int ndigits = precision;
+      while (ndigits > 1 && digits[ndigits - 1] == '0') ndigits--;
+      if (exp < -4 || exp >= precision) {
+        *end++ = digits[0];
+        if (ndigits > 1) *end++ = '.';
+        end = std::copy(digits + 1, digits + ndigits, end);
+        *end++ = 'e';
+        *end++ = exp < 0 ? '-' : '+';
+        const int abs_exp = exp < 0 ? -exp : exp;
+        end = put_digits(end, abs_exp, abs_exp >= 100 ? 3 : 2);
+      } else if (exp >= 0) {
+        end = std::copy(digits, digits + std::max(ndigits, exp + 1), end);
+        if (ndigits > exp + 1) {
+          const auto point = end - (ndigits - exp - 1);
+          std::copy_backward(point, end, end + 1);
+          *point = '.';
+          end++;
+        }
+      } else {
+        *end++ = '0';
+        *end++ = '.';
+        end = std::fill_n(end, -exp - 1, '0');
+        end = std::copy(digits, digits + ndigits, end);
+      }
+    }
+    return std::copy(buf, end, out);
+  }
+
+  virtual iter_type do_put(iter_type out, std::ios_base& str, char fill,
+                           long double val) const {
+    return do_put(out, str, fill, double(val));
+  }
+};
+
+class SignalPrinter {
+  static constexpr std::string_view cut_mark = "...";
+
+  int fd;
+  char* buffer;
+  size_t capacity;
+  PrintOptions opts;
+  fixedbuf buf;
+  std::ostream os{&buf};
+  bool cut = false;
+
+  // drops a partial UTF-8 character or escape sequence at the cut
+  size_t cut_boundary(size_t size) const {
+    size_t end = size;
+    while (end > 0 && (buffer[end - 1] & 0xc0) == 0x80) end--;
+    if (end > 0 && (buffer[end - 1] & 0x80)) {
+      const unsigned char lead = buffer[end - 1];
+      const size_t len = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2;
+      end = size - (end - 1) >= len ? size : end - 1;
+    }
+    for (size_t i = end; i > 0 && end - i < ansi::Ansi::max_size; --i) {
+      if (buffer[i - 1] != '\e') continue;
+      const char last = buffer[end - 1];
+      const bool complete = end - i >= 2 && last >= 0x40 && last <= 0x7e;
+      if (ansi::skip_escape(buffer + i - 1, buffer + end) == buffer + end &&
+          !complete)
+        end = i - 1;
+      break;
+    }
+    return end;
+  }
+
+  bool write_all(const char* data, size_t size) const {
+    while (size > 0) {
+      const ssize_t n = ::write(fd, data, size);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      data += n;
+      size -= size_t(n);
+    }
+    return true;
+  }
+
+ public:
+  // Not signal-safe itself: sets up the stream and renders a few values
+  // once, so locale caches and function-local statics exist before a
+  // signal arrives. buffer must hold more than the cut mark and a newline.
+  SignalPrinter(int fd, char* buffer, size_t size, PrintOptions opts = {})
+      : fd(fd), buffer(buffer), capacity(size), opts(opts) {
+    this->opts.memstat = false;
+    this->opts.width = 0;
+    this->opts.demangle = false;
+    this->opts.follow_pointers = false;
+    os.imbue(std::locale(std::locale::classic(), new safe_num_put));
+    ansi::set_color_mode(
+        os, opts.colors ? ansi::detect_color_mode(fd) : ansi::ColorMode::none);
+    format(std::make_tuple(0, 0.5, "", std::optional<int>{}));
+  }
+  SignalPrinter(const SignalPrinter&) = delete;
+  SignalPrinter& operator=(const SignalPrinter&) = delete;
+
+  // Renders val into the buffer; returns the rendered text
+  template <typename T>
+  std::string_view format(const T& val) {
+    const size_t reserve = cut_mark.size() + 1;  // mark and newline
+    if (capacity <= reserve) return {};
+    buf.reset(buffer, capacity - reserve);
+    os.clear();
+    PrintContext ctx{os, opts};
+    print_impl(ctx, val);
+    size_t size = buf.size();
+    cut = buf.overflowed();
+    if (cut) {
+      size = cut_boundary(size);
+      std::memcpy(buffer + size, cut_mark.data(), cut_mark.size());
+      size += cut_mark.size();
+    }
+    return {buffer, size};
+  }
+
+  // whether the last format() was cut
+  bool truncated() const { return cut; }
+
+  // Renders val followed by a newline and writes it in one write(2) call
+  // (more if interrupted); returns false on write errors
+  template <typename T>
+  bool print(const T& val) {
+    const std::string_view text = format(val);
+    if (text.data() != buffer) return false;
+    buffer[text.size()] = '\n';
+    return write_all(buffer, text.size() + 1);
+  }
+
+  bool write(std::string_view text) const {
+    return write_all(text.data(), text.size());
+  }
+};
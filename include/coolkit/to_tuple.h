@@ -88,7 +88,7 @@ REGISTER_STRUCT_TO_TUPLE(6, a1, a2, a3, a4, a5, a6)
 REGISTER_STRUCT_TO_TUPLE(7, a1, a2, a3, a4, a5, a6, a7)
 REGISTER_STRUCT_TO_TUPLE(8, a1, a2, a3, a4, a5, a6, a7, a8)
 REGISTER_STRUCT_TO_TUPLE(9, a1, a2, a3, a4, a5, a6, a7, a8, a9)
-REGISTER_STRUCT_TO_TUPLE(10, a1, a2, a3, a4, a5, a6, a7, a8, a10)
+REGISTER_STRUCT_TO_TUPLE(10, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10)
 
 }  // namespace _detail
 
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+// Helper to detect if type has ostream operator
+template <typename T, typename = void>
+struct has_ostream_operator : std::false_type {};
+
+template <typename T>
+struct has_ostream_operator<
+    T,
+    std::void_t<decltype(std::declval<std::ostream&>() << std::declval<T>())>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool has_ostream_operator_v = has_ostream_operator<T>::value;
+
+// Helper to detect types comparable with operator==
+template <typename T, typename = void>
+struct is_equality_comparable : std::false_type {};
+
+template <typename T>
+struct is_equality_comparable<
+    T, std::void_t<decltype(std::declval<const T&>() ==
+                            std::declval<const T&>())>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_equality_comparable_v = is_equality_comparable<T>::value;
+
+// Helper to detect iterable types
+template <typename T, typename = void>
+struct is_range : std::false_type {};
+
+template <typename T>
+struct is_range<T, std::void_t<decltype(std::begin(std::declval<T>())),
+                               decltype(std::end(std::declval<T>()))>>
+    : std::true_type {};
+
+template <typename T>
+struct is_range<T, std::enable_if_t<std::is_array_v<T>>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_range_v = is_range<T>::value;
+
+// Helper to detect if type is a set-like container
+template <typename T, typename = void>
+struct has_keys : std::false_type {};
+
+template <typename T>
+struct has_keys<T, std::void_t<typename T::key_type, typename T::value_type>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool has_keys_v = has_keys<T>::value;
+
+// Helper to detect if type is a map-like container
+template <typename T, typename = void>
+struct is_map_like : std::false_type {};
+
+template <typename T>
+struct is_map_like<T,
+                   std::void_t<typename T::key_type, typename T::mapped_type>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool is_map_like_v = is_map_like<T>::value;
+
+// Helper to detect ranges with contiguous storage (std::data/std::size)
+template <typename T, typename = void>
+struct is_contiguous_range : std::false_type {};
+
+template <typename T>
+struct is_contiguous_range<T,
+                           std::void_t<decltype(std::data(std::declval<T&>())),
+                                       decltype(std::size(std::declval<T&>()))>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool is_contiguous_range_v = is_contiguous_range<T>::value;
+
+// Helper to detect contiguous ranges of raw bytes, e.g. std::vector<uint8_t>
+// or std::array<std::byte, N>
+template <typename T>
+constexpr bool is_byte_v =
+    std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+    std::is_same_v<T, unsigned char> || std::is_same_v<T, std::byte>;
+
+template <typename T, typename = void>
+struct is_byte_range : std::false_type {};
+
+template <typename T>
+struct is_byte_range<T, std::void_t<decltype(std::data(std::declval<T&>())),
+                                    decltype(std::size(std::declval<T&>()))>>
+    : std::bool_constant<is_byte_v<std::remove_cv_t<std::remove_pointer_t<
+          decltype(std::data(std::declval<T&>()))>>>> {};
+
+template <typename T>
+constexpr bool is_byte_range_v = is_byte_range<T>::value;
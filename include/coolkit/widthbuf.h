@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstring>
+#include <streambuf>
+
+// Output buffer that only counts characters and fails as soon as the text
+// no longer fits on one line of `limit` columns, so measuring a flat
+// rendering stops early
+class widthbuf : public std::streambuf {
+  size_t count = 0;
+  size_t limit = 0;
+
+  bool fail() {
+    count = limit + 1;
+    return false;
+  }
+
+ protected:
+  virtual int overflow(int ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+      return traits_type::not_eof(ch);
+    if (ch == '\n' || count >= limit) return fail(), traits_type::eof();
+    count++;
+    return ch;
+  }
+
+  virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+    const size_t size = static_cast<size_t>(n);
+    if (count > limit || size > limit - count || std::memchr(s, '\n', size))
+      return fail(), 0;
+    count += size;
+    return n;
+  }
+
+ public:
+  void reset(size_t limit) {
+    this->count = 0;
+    this->limit = limit;
+  }
+  size_t size() const { return count; }
+  bool overflowed() const { return count > limit; }
+};
@@ -19,6 +19,9 @@
 #include "coolkit/indentos.h"
 #include "coolkit/macro.h"
 #include "coolkit/memstat.h"
+#include "coolkit/memstat_layout.h"
+#include "coolkit/memstat_slack.h"
+#include "coolkit/memstat_tree.h"
 #include "coolkit/pprint.h"
 
 // Custom type with ostream operator
@@ -148,6 +151,9 @@ int main(int, char**) {
 
   std::vector<Person2> vp2{p2, p2};
   printout(vp2);
+  std::cerr << memstat_tree(vp2, {"vp2"});
+  std::cerr << memstat_slack(vp2, {"vp2"});
+  std::cerr << struct_layout<Person2>(vp2);
 
   std::string str = "codingcodingcoding";
   printout(sizeof(str));
@@ -159,6 +165,8 @@ int main(int, char**) {
   static constexpr auto val1 = Enum<Values>::values;
   static constexpr auto val2 = Enum<Values>::string(Values::Some);
   Enum<Values>::foreach (printout<Values>);
+  printout(Enum<Values>::visit(
+      Values::Sort, [](auto value) { return Enum<Values>::string(value); }));
 
   return 0;
 }